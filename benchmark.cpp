@@ -1,10 +1,30 @@
 #include "plain_da.hpp"
+#include "compact_da.hpp"
+#include "concurrent_trie.hpp"
+#include "perf_counters.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <chrono>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <functional>
 
 #include "keyset.hpp"
+#include "keyset_generator.hpp"
 #include "double_array_base.hpp"
 
 namespace {
@@ -17,173 +37,709 @@ double ProcessTime(Fn fn) {
   return std::chrono::duration<double, std::micro>(now-start).count();
 }
 
+// Print the stats of Build for tries collecting them.
+template <class Trie>
+auto PrintBuildStats(const Trie& trie, int) -> decltype(trie.build_stats(), void()) {
+  trie.build_stats().Print(std::cout);
+}
+template <class Trie>
+void PrintBuildStats(const Trie&, long) {}
+
+template <class Trie, class = void>
+struct HasCommonPrefixSearch : std::false_type {};
+template <class Trie>
+struct HasCommonPrefixSearch<Trie, std::void_t<
+    decltype(std::declval<const Trie&>().common_prefix_search(std::string_view()))>> : std::true_type {};
+
+template <class Trie, class = void>
+struct HasLongestPrefix : std::false_type {};
+template <class Trie>
+struct HasLongestPrefix<Trie, std::void_t<
+    decltype(std::declval<const Trie&>().longest_prefix(std::string_view()))>> : std::true_type {};
+
+template <class Trie, class = void>
+struct HasInsert : std::false_type {};
+template <class Trie>
+struct HasInsert<Trie, std::void_t<
+    decltype(std::declval<Trie&>().Insert(std::string_view()))>> : std::true_type {};
+
+template <class Trie, class = void>
+struct HasPredictiveSearch : std::false_type {};
+template <class Trie>
+struct HasPredictiveSearch<Trie, std::void_t<
+    decltype(std::declval<const Trie&>().predictive_search(std::string_view()))>> : std::true_type {};
+
 constexpr int BenchKeyCounts = 1000000;
 constexpr int LoopTimes = 10;
+// Number of queries timed together as a sample of the latency distribution.
+constexpr size_t SampleSize = 256;
+constexpr double ZipfExponent = 1.0;
+// Runs of each thread in the scaling mode, fewer than LoopTimes as the threads can exceed the cores.
+constexpr int ScalingLoopTimes = 3;
+// Keys enumerated by each query of predictive_search, as the first page of completions.
+constexpr size_t PredictiveSearchLimit = 10;
+// Keys inserted and erased in turn by the writer of the scaling mode.
+constexpr size_t NumWriterKeys = 1000;
+
+enum class Operation {
+  kContains,
+  kContainsBatch,
+  kCommonPrefixSearch,
+  kLongestPrefix,
+  kPredictiveSearch,
+};
+
+struct Workload {
+  std::string name;
+  Operation operation;
+  std::vector<std::string> queries;
+  size_t num_hits; // Expected results to validate runs of contains
+};
+
+// Whether runs of operation count the hits of contains, which are known before the runs.
+constexpr bool CountsHits(Operation operation) {
+  return operation == Operation::kContains or operation == Operation::kContainsBatch;
+}
+
+struct WorkloadResult {
+  std::string name;
+  double mean_ns;
+  // Percentiles of the mean times of samples of SampleSize queries, not of the times of single queries,
+  // which timers cannot resolve without distorting them.
+  double sample_median_ns;
+  double sample_p99_ns;
+  std::optional<double> events[plain_da::PerfCounters::kNumEvents];
+};
+
+// Aggregate throughput and latencies of each thread sharing a trie.
+struct ScalingResult {
+  std::string workload;
+  size_t num_threads;
+  // Whether a writer thread updated the trie through ConcurrentTrie during the runs, and its rate.
+  bool with_writer = false;
+  double writer_updates_per_second = 0;
+  double throughput_mqps;
+  // Percentiles of the mean times of samples of each thread as WorkloadResult.
+  std::vector<double> sample_median_ns;
+  std::vector<double> sample_p99_ns;
+};
+
+struct TrieResult {
+  std::string name;
+  double construction_seconds;
+  size_t size;
+  size_t num_keys;
+  plain_da::MemoryUsage memory;
+  std::vector<WorkloadResult> workloads;
+  std::vector<ScalingResult> scaling;
+};
+
+// Query workloads drawn from keyset.
+std::vector<Workload> MakeWorkloads(const plain_da::KeysetHandler& keyset) {
+  std::mt19937_64 gen(0);
+  std::uniform_int_distribution<size_t> uniform(0, keyset.size() - 1);
+  std::unordered_set<std::string_view> keys(keyset.begin(), keyset.end());
+  std::vector<Workload> workloads;
+
+  Workload random_hit{"random_hit", Operation::kContains, {}, BenchKeyCounts};
+  for (int i = 0; i < BenchKeyCounts; i++)
+    random_hit.queries.emplace_back(keyset[uniform(gen)]);
+
+  Workload sorted_hit = random_hit;
+  sorted_hit.name = "sorted_hit";
+  std::sort(sorted_hit.queries.begin(), sorted_hit.queries.end());
+
+  Workload batch_hit = random_hit;
+  batch_hit.name = "random_hit_batch";
+  batch_hit.operation = Operation::kContainsBatch;
+
+  // Ranks of the skewed distribution are shuffled not to correlate with the order of keys.
+  Workload zipf_hit{"zipf_hit", Operation::kContains, {}, BenchKeyCounts};
+  {
+    std::vector<size_t> ids(keyset.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    std::shuffle(ids.begin(), ids.end(), gen);
+    std::vector<double> weights(keyset.size());
+    for (size_t r = 0; r < weights.size(); r++)
+      weights[r] = 1 / std::pow(r + 1, ZipfExponent);
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    for (int i = 0; i < BenchKeyCounts; i++)
+      zipf_hit.queries.emplace_back(keyset[ids[zipf(gen)]]);
+  }
+
+  // Half of the queries miss by a mutated character, mostly deep in the trie.
+  Workload mixed{"mixed_hit_miss", Operation::kContains, {}, 0};
+  for (int i = 0; i < BenchKeyCounts; i++) {
+    std::string query(keyset[uniform(gen)]);
+    if (i % 2 == 1) {
+      do {
+        if (query.empty() or gen() % 4 == 0)
+          query.push_back('a' + gen() % 26);
+        else
+          query[gen() % query.size()] = 'a' + gen() % 26;
+      } while (keys.count(query));
+    }
+    mixed.num_hits += keys.count(query);
+    mixed.queries.push_back(std::move(query));
+  }
+
+  Workload prefix{"common_prefix_search", Operation::kCommonPrefixSearch, random_hit.queries, 0};
+
+  // Keys with mutations, whose longest prefixes are mostly shorter than them.
+  Workload longest{"longest_prefix", Operation::kLongestPrefix, mixed.queries, 0};
+
+  // Prefixes of keys of random lengths, completed to the first PredictiveSearchLimit keys.
+  Workload predictive{"predictive_search", Operation::kPredictiveSearch, {}, 0};
+  for (auto& key : random_hit.queries)
+    predictive.queries.push_back(key.substr(0, key.empty() ? 0 : 1 + gen() % key.size()));
+
+  workloads.push_back(std::move(random_hit));
+  workloads.push_back(std::move(sorted_hit));
+  workloads.push_back(std::move(batch_hit));
+  workloads.push_back(std::move(zipf_hit));
+  workloads.push_back(std::move(mixed));
+  workloads.push_back(std::move(prefix));
+  workloads.push_back(std::move(longest));
+  workloads.push_back(std::move(predictive));
+  return workloads;
+}
+
+template <class Trie>
+constexpr bool Supports(Operation operation) {
+  switch (operation) {
+    case Operation::kCommonPrefixSearch:
+      return HasCommonPrefixSearch<Trie>::value;
+    case Operation::kLongestPrefix:
+      return HasLongestPrefix<Trie>::value;
+    case Operation::kPredictiveSearch:
+      return HasPredictiveSearch<Trie>::value;
+    default:
+      return true;
+  }
+}
+
+// Run queries [begin, end) of workload, and return the number of results.
+template <class Trie>
+size_t RunSample(const Trie& trie, const Workload& workload, size_t begin, size_t end, std::vector<char>& results) {
+  auto& queries = workload.queries;
+  size_t count = 0;
+  switch (workload.operation) {
+    case Operation::kContains:
+      for (size_t i = begin; i < end; i++)
+        count += trie.contains(std::string_view(queries[i]));
+      break;
+    case Operation::kContainsBatch:
+      trie.contains_batch(queries.begin() + begin, queries.begin() + end, results.begin());
+      count += std::count(results.begin(), results.begin() + (end - begin), true);
+      break;
+    case Operation::kCommonPrefixSearch:
+      if constexpr (HasCommonPrefixSearch<Trie>::value) {
+        for (size_t i = begin; i < end; i++)
+          count += trie.common_prefix_search(queries[i]).size();
+      }
+      break;
+    case Operation::kLongestPrefix:
+      if constexpr (HasLongestPrefix<Trie>::value) {
+        for (size_t i = begin; i < end; i++) {
+          if (auto result = trie.longest_prefix(queries[i]))
+            count += result->first;
+        }
+      }
+      break;
+    case Operation::kPredictiveSearch:
+      if constexpr (HasPredictiveSearch<Trie>::value) {
+        for (size_t i = begin; i < end; i++) {
+          size_t n = 0;
+          for (auto cursor = trie.predictive_search(queries[i]); cursor and n < PredictiveSearchLimit; ++cursor)
+            n++;
+          count += n;
+        }
+      }
+      break;
+  }
+  return count;
+}
+
+// Run a sample on the instance published by ConcurrentTrie, as a reader would.
+template <class Trie>
+size_t RunSample(const plain_da::ConcurrentTrie<Trie>& trie, const Workload& workload, size_t begin, size_t end,
+                 std::vector<char>& results) {
+  return trie.read([&](const Trie& instance) { return RunSample(instance, workload, begin, end, results); });
+}
+
+// Run all queries of workload from the sample at offset round to the end, appending the time per query
+// of every SampleSize queries to samples if given.
+template <class Trie>
+size_t RunStream(const Trie& trie, const Workload& workload, size_t offset, std::vector<double>* samples) {
+  auto& queries = workload.queries;
+  size_t num_samples = (queries.size() + SampleSize - 1) / SampleSize;
+  std::vector<char> results(SampleSize);
+  size_t count = 0;
+  for (size_t i = 0; i < num_samples; i++) {
+    auto begin = (offset + i) % num_samples * SampleSize;
+    auto end = std::min(begin + SampleSize, queries.size());
+    if (!samples) {
+      count += RunSample(trie, workload, begin, end, results);
+      continue;
+    }
+    auto start_t = std::chrono::steady_clock::now();
+    count += RunSample(trie, workload, begin, end, results);
+    auto end_t = std::chrono::steady_clock::now();
+    samples->push_back(std::chrono::duration<double, std::nano>(end_t - start_t).count() / (end - begin));
+  }
+  return count;
+}
+
+double Percentile(const std::vector<double>& sorted_samples, size_t percent) {
+  return sorted_samples[std::min(sorted_samples.size() - 1, sorted_samples.size() * percent / 100)];
+}
+
+// Run workload LoopTimes times, timing every SampleSize queries.
+template <class Trie>
+std::optional<WorkloadResult> RunWorkload(const Trie& trie, const Workload& workload) {
+  if (!Supports<Trie>(workload.operation))
+    return std::nullopt;
+
+  // Warm up, and fix the expected count of the searches by the first run.
+  size_t expected = RunStream(trie, workload, 0, nullptr);
+  if (CountsHits(workload.operation) and expected != workload.num_hits) {
+    std::cout << "ERROR! " << workload.name << " found " << expected << " keys, not " << workload.num_hits << std::endl;
+    return std::nullopt;
+  }
+
+  std::vector<double> samples;
+  plain_da::PerfCounters counters;
+  counters.Start();
+  for (int loop = 0; loop < LoopTimes; loop++) {
+    if (RunStream(trie, workload, 0, &samples) != expected) {
+      std::cout << "ERROR! " << workload.name << " is not deterministic" << std::endl;
+      return std::nullopt;
+    }
+  }
+  counters.Stop();
+
+  WorkloadResult result;
+  result.name = workload.name;
+  result.mean_ns = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  std::sort(samples.begin(), samples.end());
+  result.sample_median_ns = Percentile(samples, 50);
+  result.sample_p99_ns = Percentile(samples, 99);
+  double num_queries = (double) workload.queries.size() * LoopTimes;
+  for (int event = 0; event < plain_da::PerfCounters::kNumEvents; event++) {
+    if (auto value = counters.value(plain_da::PerfCounters::Event(event)))
+      result.events[event] = *value / num_queries;
+  }
+  return result;
+}
+
+// Writer updating a trie until done is set, which returns the number of updates.
+using Writer = std::function<size_t(const std::atomic<bool>& done)>;
 
-template <class Da>
-void Benchmark(const plain_da::KeysetHandler& keyset, const plain_da::RawTrie& trie, const plain_da::KeysetHandler& bench_keyset) {
-  Da plain_da;
+// Share trie among num_threads threads each running workload ScalingLoopTimes times,
+// while writer, if given, runs on another thread.
+// Threads start from distinct offsets of the queries so that they do not look up the same keys in lockstep.
+template <class Trie>
+std::optional<ScalingResult> RunScaling(const Trie& trie, const Workload& workload, size_t num_threads,
+                                        const Writer& writer = nullptr) {
+  size_t num_samples = (workload.queries.size() + SampleSize - 1) / SampleSize;
+  // Results of each thread, merged after the runs. Threads keep them local during the runs,
+  // since the adjacent slots would share cache lines written on every sample.
+  std::vector<std::vector<double>> samples(num_threads);
+  std::vector<size_t> counts(num_threads);
+  std::atomic<size_t> ready = 0;
+  std::atomic<bool> start = false;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      std::vector<double> thread_samples;
+      thread_samples.reserve(ScalingLoopTimes * num_samples);
+      size_t count = 0;
+      ready++;
+      while (!start)
+        std::this_thread::yield();
+      for (int loop = 0; loop < ScalingLoopTimes; loop++)
+        count += RunStream(trie, workload, num_samples * t / num_threads, &thread_samples);
+      samples[t] = std::move(thread_samples);
+      counts[t] = count;
+    });
+  }
+  while (ready < num_threads)
+    std::this_thread::yield();
+  std::atomic<bool> done = false;
+  size_t num_updates = 0;
+  std::thread writer_thread;
+  if (writer) {
+    writer_thread = std::thread([&] {
+      while (!start)
+        std::this_thread::yield();
+      num_updates = writer(done);
+    });
+  }
+  auto start_t = std::chrono::steady_clock::now();
+  start = true;
+  for (auto& thread : threads)
+    thread.join();
+  auto end_t = std::chrono::steady_clock::now();
+  done = true;
+  if (writer_thread.joinable())
+    writer_thread.join();
+
+  ScalingResult result;
+  result.workload = workload.name;
+  result.num_threads = num_threads;
+  auto seconds = std::chrono::duration<double>(end_t - start_t).count();
+  result.with_writer = (bool) writer;
+  result.writer_updates_per_second = num_updates / seconds;
+  result.throughput_mqps = (double) workload.queries.size() * ScalingLoopTimes * num_threads / seconds / 1000000;
+  for (size_t t = 0; t < num_threads; t++) {
+    if (CountsHits(workload.operation) and counts[t] != workload.num_hits * ScalingLoopTimes) {
+      std::cout << "ERROR! " << workload.name << " found " << counts[t] << " keys on thread " << t << std::endl;
+      return std::nullopt;
+    }
+    std::sort(samples[t].begin(), samples[t].end());
+    result.sample_median_ns.push_back(Percentile(samples[t], 50));
+    result.sample_p99_ns.push_back(Percentile(samples[t], 99));
+  }
+  return result;
+}
+
+void PrintWorkloadResult(const WorkloadResult& result) {
+  using plain_da::PerfCounters;
+  std::cout << result.name << ": \tmean " << result.mean_ns << " ns, sample median " << result.sample_median_ns
+            << " ns, sample p99 " << result.sample_p99_ns << " ns /query" << std::endl;
+  for (int event = 0; event < PerfCounters::kNumEvents; event++) {
+    std::cout << "\t" << PerfCounters::kEventNames[event] << ": ";
+    if (result.events[event])
+      std::cout << *result.events[event] << " /query" << std::endl;
+    else
+      std::cout << "n/a" << std::endl;
+  }
+}
+
+void PrintScalingResult(const ScalingResult& result) {
+  std::cout << result.workload << " on " << result.num_threads << " threads";
+  if (result.with_writer)
+    std::cout << " with a writer (" << result.writer_updates_per_second << " updates/s)";
+  std::cout << ": \t"
+            << result.throughput_mqps << " Mqueries/s, sample median "
+            << *std::max_element(result.sample_median_ns.begin(), result.sample_median_ns.end()) << " ns, sample p99 "
+            << *std::max_element(result.sample_p99_ns.begin(), result.sample_p99_ns.end()) << " ns /query of the slowest thread"
+            << std::endl;
+}
+
+struct Context {
+  const plain_da::KeysetHandler& keyset;
+  const plain_da::RawTrie& trie;
+  const std::vector<Workload>& workloads;
+  std::string filter;
+  // Thread counts of the scaling mode, which is disabled if empty.
+  std::vector<size_t> thread_counts;
+  std::string scaling_workload;
+  // Keys of the writer of the scaling mode, which no query of contains hits.
+  std::vector<std::string> writer_keys;
+  std::vector<TrieResult> results;
+};
+
+// Keys of keyset followed by '\x01', which are not keys of keyset.
+std::vector<std::string> MakeWriterKeys(const plain_da::KeysetHandler& keyset) {
+  std::unordered_set<std::string_view> keys(keyset.begin(), keyset.end());
+  std::vector<std::string> writer_keys;
+  size_t n = std::min(NumWriterKeys, keyset.size());
+  for (size_t i = 0; i < n; i++) {
+    auto key = std::string(keyset[i * keyset.size() / n]) + '\x01';
+    if (!keys.count(key))
+      writer_keys.push_back(std::move(key));
+  }
+  return writer_keys;
+}
+
+// RunScaling over ConcurrentTrie holding a copy of trie, while a writer inserts all writer_keys and erases them
+// in turn. The readers see the keys of trie contained throughout, since no writer key is one of them.
+template <class Trie>
+std::optional<ScalingResult> RunScalingWithWriter(const Trie& trie, const Workload& workload, size_t num_threads,
+                                                  const std::vector<std::string>& writer_keys) {
+  if (writer_keys.empty())
+    return std::nullopt;
+  plain_da::ConcurrentTrie<Trie> concurrent{Trie(trie)};
+  return RunScaling(concurrent, workload, num_threads, [&](const std::atomic<bool>& done) {
+    size_t num_updates = 0;
+    for (; !done; num_updates++) {
+      auto& key = writer_keys[num_updates % writer_keys.size()];
+      if (num_updates / writer_keys.size() % 2 == 0)
+        concurrent.Insert(key);
+      else
+        concurrent.Erase(key);
+    }
+    return num_updates;
+  });
+}
+
+template <class Trie>
+void Benchmark(const std::string& name, Context& context) {
+  if (name.find(context.filter) == std::string::npos)
+    return;
+  std::cout << "- " << name << std::endl;
+  TrieResult result;
+  result.name = name;
+  Trie trie;
   auto construction_time = ProcessTime([&] {
-    plain_da.Build(trie);
+    trie.Build(context.trie);
   });
-  std::cout << "construction_time: \t" << construction_time/1000000 << " s" << std::endl;
-
-  { // Check is construction perfect.
-    std::cout << "Test..." << std::endl;
-    for (auto &key : keyset) {
-      bool ok = plain_da.contains(key);
-      if (!ok) {
-        std::cout << "NG" << std::endl;
-        std::cout << "ERROR! " << key << "\t is not contained!" << std::endl;
-        return;
+  PrintBuildStats(trie, 0);
+  result.construction_seconds = construction_time/1000000;
+  result.size = trie.size();
+  result.num_keys = trie.num_keys();
+  result.memory = trie.memory_usage();
+  std::cout << "construction_time: \t" << result.construction_seconds << " s" << std::endl;
+  result.memory.Print(std::cout, result.num_keys);
+
+  for (auto& key : context.keyset) {
+    if (!trie.contains(key)) {
+      std::cout << "ERROR! " << key << "\t is not contained!" << std::endl;
+      return;
+    }
+  }
+
+  for (auto& workload : context.workloads) {
+    auto workload_result = RunWorkload(trie, workload);
+    if (!workload_result)
+      continue;
+    PrintWorkloadResult(*workload_result);
+    result.workloads.push_back(*workload_result);
+  }
+
+  for (auto& workload : context.workloads) {
+    if (workload.name != context.scaling_workload or !Supports<Trie>(workload.operation))
+      continue;
+    for (auto num_threads : context.thread_counts) {
+      auto scaling_result = RunScaling(trie, workload, num_threads);
+      if (!scaling_result)
+        break;
+      PrintScalingResult(*scaling_result);
+      result.scaling.push_back(*scaling_result);
+    }
+    // Readers under updates, for the tries ConcurrentTrie can update.
+    if constexpr (HasInsert<Trie>::value) {
+      for (auto num_threads : context.thread_counts) {
+        auto scaling_result = RunScalingWithWriter(trie, workload, num_threads, context.writer_keys);
+        if (!scaling_result)
+          break;
+        PrintScalingResult(*scaling_result);
+        result.scaling.push_back(*scaling_result);
       }
     }
-    std::cout << "OK" << std::endl;
   }
+  std::cout << std::endl;
+  context.results.push_back(std::move(result));
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+// Tries collecting the stats of Build, which cost a timer read per FindBase on the construction time.
+template <typename DaType, bool EdgeOrdering>
+using StatsPlainDaTrie = plain_da::PlainDaTrie<DaType, EdgeOrdering, plain_da::BuildStats>;
+template <typename DaType, bool EdgeOrdering>
+using StatsPlainDaMpTrie = plain_da::PlainDaMpTrie<DaType, EdgeOrdering, plain_da::BuildStats>;
+
+template <template <typename, bool> class Trie, typename OperationTag, bool EdgeOrdering>
+void BenchmarkConstructionTypes(const std::string& name, Context& context) {
+  using namespace plain_da;
+  std::string suffix = EdgeOrdering ? " EdgeOrdering" : "";
+  Benchmark<Trie<Da<OperationTag, ELM_xcheck_tag>, EdgeOrdering>>(name + " ELM" + suffix, context);
+  Benchmark<Trie<Da<OperationTag, WW_xcheck_tag>, EdgeOrdering>>(name + " WW" + suffix, context);
+  Benchmark<Trie<Da<OperationTag, WW_ELM_xcheck_tag>, EdgeOrdering>>(name + " WW_ELM" + suffix, context);
+  Benchmark<Trie<Da<OperationTag, CNV_xcheck_tag>, EdgeOrdering>>(name + " CNV" + suffix, context);
+  Benchmark<Trie<Da<OperationTag, CNV_ELM_xcheck_tag>, EdgeOrdering>>(name + " CNV_ELM" + suffix, context);
+}
+
+// Quote str as a JSON string, escaping control characters too.
+std::string JsonString(std::string_view str) {
+  std::string escaped = "\"";
+  for (char c : str) {
+    switch (c) {
+      case '"': escaped += "\\\""; break;
+      case '\\': escaped += "\\\\"; break;
+      case '\b': escaped += "\\b"; break;
+      case '\f': escaped += "\\f"; break;
+      case '\n': escaped += "\\n"; break;
+      case '\r': escaped += "\\r"; break;
+      case '\t': escaped += "\\t"; break;
+      default:
+        if ((unsigned char) c < 0x20) {
+          char code[7];
+          std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char) c);
+          escaped += code;
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped + "\"";
+}
 
-  auto bench_for_random_keys = [&] {
-    for (auto &key : bench_keyset) {
-      bool ok = plain_da.contains(key);
-      if (!ok) {
-        std::cout << "ERROR! " << key << "\t is not contained!" << std::endl;
-        return;
+void WriteJson(std::ostream& os, const std::string& keyset_path, const Context& context) {
+  using plain_da::PerfCounters;
+  os << "{\n";
+  os << "  \"keyset\": " << JsonString(keyset_path) << ",\n";
+  os << "  \"num_keys\": " << context.keyset.size() << ",\n";
+  os << "  \"num_queries\": " << BenchKeyCounts << ",\n";
+  os << "  \"loop_times\": " << LoopTimes << ",\n";
+  os << "  \"sample_size\": " << SampleSize << ",\n";
+  os << "  \"scaling_loop_times\": " << ScalingLoopTimes << ",\n";
+  os << "  \"results\": [";
+  for (size_t i = 0; i < context.results.size(); i++) {
+    auto& result = context.results[i];
+    os << (i ? ",\n" : "\n");
+    os << "    {\n";
+    os << "      \"trie\": " << JsonString(result.name) << ",\n";
+    os << "      \"construction_seconds\": " << result.construction_seconds << ",\n";
+    os << "      \"size\": " << result.size << ",\n";
+    auto& memory = result.memory;
+    os << "      \"size_in_bytes\": " << memory.total() << ",\n";
+    os << "      \"bytes_per_key\": " << (double) memory.total() / result.num_keys << ",\n";
+    os << "      \"memory\": {\"da_units\": " << memory.da_units
+       << ", \"wasted\": " << memory.wasted
+       << ", \"exists_bits\": " << memory.exists_bits
+       << ", \"page_counts\": " << memory.page_counts
+       << ", \"tail\": " << memory.tail
+       << ", \"leaves\": " << memory.leaves
+       << ", \"links\": " << memory.links
+       << ", \"fill_ratio\": " << memory.fill_ratio() << "},\n";
+    os << "      \"workloads\": [";
+    for (size_t j = 0; j < result.workloads.size(); j++) {
+      auto& workload = result.workloads[j];
+      os << (j ? ",\n" : "\n");
+      os << "        {\"name\": " << JsonString(workload.name)
+         << ", \"mean_ns\": " << workload.mean_ns
+         << ", \"sample_median_ns\": " << workload.sample_median_ns
+         << ", \"sample_p99_ns\": " << workload.sample_p99_ns;
+      for (int event = 0; event < PerfCounters::kNumEvents; event++) {
+        os << ", \"" << PerfCounters::kEventNames[event] << "\": ";
+        if (workload.events[event])
+          os << *workload.events[event];
+        else
+          os << "null";
       }
+      os << "}";
     }
-  };
-  { // Warm up
-    bench_for_random_keys();
+    os << "\n      ],\n";
+    os << "      \"scaling\": [";
+    for (size_t j = 0; j < result.scaling.size(); j++) {
+      auto& scaling = result.scaling[j];
+      auto write_array = [&](const std::vector<double>& values) {
+        os << "[";
+        for (size_t t = 0; t < values.size(); t++)
+          os << (t ? ", " : "") << values[t];
+        os << "]";
+      };
+      os << (j ? ",\n" : "\n");
+      os << "        {\"workload\": " << JsonString(scaling.workload)
+         << ", \"threads\": " << scaling.num_threads
+         << ", \"with_writer\": " << (scaling.with_writer ? "true" : "false")
+         << ", \"writer_updates_per_second\": " << scaling.writer_updates_per_second
+         << ", \"throughput_mqps\": " << scaling.throughput_mqps
+         << ", \"sample_median_ns\": ";
+      write_array(scaling.sample_median_ns);
+      os << ", \"sample_p99_ns\": ";
+      write_array(scaling.sample_p99_ns);
+      os << "}";
+    }
+    os << (result.scaling.empty() ? "]\n" : "\n      ]\n");
+    os << "    }";
   }
-  auto lookup_time = ProcessTime([&] {
-    for (int i = 0; i < LoopTimes; i++) {
-      bench_for_random_keys();
+  os << "\n  ]\n";
+  os << "}\n";
+}
+
+// Read the keyset from the file, or generate the keyset described as synthetic:shape:num_keys[:seed].
+plain_da::KeysetHandler LoadKeyset(const std::string& source) {
+  constexpr std::string_view kSyntheticPrefix = "synthetic:";
+  if (source.compare(0, kSyntheticPrefix.size(), kSyntheticPrefix) == 0) {
+    std::stringstream ss(source.substr(kSyntheticPrefix.size()));
+    std::string shape, num_keys, seed = "0";
+    std::getline(ss, shape, ':');
+    std::getline(ss, num_keys, ':');
+    std::getline(ss, seed, ':');
+    try {
+      return plain_da::MakeSyntheticKeyset(plain_da::ParseKeysetShape(shape), std::stoull(num_keys), std::stoull(seed));
+    } catch (const std::exception& e) {
+      std::cerr << source << ": " << e.what() << std::endl;
+      exit(EXIT_FAILURE);
     }
-  });
-  std::cout << "lookup_time: \t" << lookup_time/BenchKeyCounts/LoopTimes << " µs/key" << std::endl << std::endl;
+  }
+  std::ifstream ifs(source);
+  if (!ifs) {
+    std::cerr << source << " is not found!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return plain_da::KeysetHandler(ifs);
 }
 
 }
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
-    std::cout << "Usage: " << argv[0] << " [keyset]" << std::endl;
+    std::cout << "Usage: " << argv[0] << " [keyset file or synthetic:(url|word|dna|numeric|path):num_keys[:seed]]"
+              << " [--json=output.json] [--filter=substring of trie names]"
+              << " [--threads=1,2,4,...] [--scaling_workload=random_hit]" << std::endl;
     exit(EXIT_FAILURE);
   }
+  std::string json_path, filter, scaling_workload = "random_hit";
+  std::vector<size_t> thread_counts;
+  for (int i = 2; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, 7) == "--json=") {
+      json_path = arg.substr(7);
+    } else if (arg.substr(0, 9) == "--filter=") {
+      filter = arg.substr(9);
+    } else if (arg.substr(0, 10) == "--threads=") {
+      std::stringstream ss(std::string(arg.substr(10)));
+      std::string count;
+      while (std::getline(ss, count, ',')) {
+        thread_counts.push_back(std::stoul(count));
+        if (thread_counts.back() == 0) {
+          std::cerr << "Number of threads must be positive" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+      }
+    } else if (arg.substr(0, 19) == "--scaling_workload=") {
+      scaling_workload = arg.substr(19);
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
 
-  std::ifstream ifs(argv[1]);
-  if (!ifs) {
-    std::cerr << argv[1] << " is not found!" << std::endl;
+  auto keyset = LoadKeyset(argv[1]);
+  plain_da::RawTrie trie(keyset);
+  auto workloads = MakeWorkloads(keyset);
+  if (!thread_counts.empty() and
+      std::none_of(workloads.begin(), workloads.end(), [&](auto& w) { return w.name == scaling_workload; })) {
+    std::cerr << "Unknown workload " << scaling_workload << std::endl;
     exit(EXIT_FAILURE);
   }
-  plain_da::KeysetHandler keyset(ifs);
-  plain_da::RawTrie trie(keyset);
-  plain_da::KeysetHandler bench_keyset;
-  for (int i = 0; i < BenchKeyCounts; i++)
-    bench_keyset.insert(keyset[random()%keyset.size()]);
-  bench_keyset.update_list();
-
-  // PLUS
-
-  std::cout << "- MP+ - EmptyLink" << std::endl;
-  Benchmark<plain_da::PlainDaMpTrie<
-      plain_da::DoubleArrayBase<
-          plain_da::da_plus_operation_tag,
-          plain_da::ELM_xcheck_tag
-          >,
-      false
-      >>(keyset, trie, bench_keyset);
-  std::cout << "- MP+ - BitParallelism" << std::endl;
-  Benchmark<plain_da::PlainDaMpTrie<
-      plain_da::DoubleArrayBase<
-          plain_da::da_plus_operation_tag,
-          plain_da::WW_xcheck_tag
-      >,
-      false
-  >>(keyset, trie, bench_keyset);
-  std::cout << "- MP+ - BitParallelism + Empty-Link" << std::endl;
-  Benchmark<plain_da::PlainDaMpTrie<
-      plain_da::DoubleArrayBase<
-          plain_da::da_plus_operation_tag,
-          plain_da::WW_ELM_xcheck_tag
-      >,
-      false
-  >>(keyset, trie, bench_keyset);
-  std::cout << "- MP+ - Convolution" << std::endl;
-  Benchmark<plain_da::PlainDaMpTrie<
-      plain_da::DoubleArrayBase<
-          plain_da::da_plus_operation_tag,
-          plain_da::CNV_xcheck_tag
-      >,
-      false
-  >>(keyset, trie, bench_keyset);
-  std::cout << "- MP+ - Convolution + Empty-Link" << std::endl;
-  Benchmark<plain_da::PlainDaMpTrie<
-      plain_da::DoubleArrayBase<
-          plain_da::da_plus_operation_tag,
-          plain_da::CNV_ELM_xcheck_tag
-      >,
-      false
-  >>(keyset, trie, bench_keyset);
-
-
-  // XOR
-
-//  std::cout << "- MPx - EmptyLink" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::ELM_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-//  std::cout << "- MPx - BitParallelism" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::WW_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-//  std::cout << "- MPx - BitParallelism + Empty-Link" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::WW_ELM_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-
-//  std::cout << "- MPx - BitParallelism" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::WW_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-//  std::cout << "- MPx - BitParallelism - Empty-Link" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::WW_ELM_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-//  std::cout << "- MPx - Convolution" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::CNV_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
-//  std::cout << "- MPx - Convolution + Empty-Link" << std::endl;
-//  Benchmark<plain_da::PlainDaMpTrie<
-//      plain_da::DoubleArrayBase<
-//          plain_da::da_xor_operation_tag,
-//          plain_da::CNV_ELM_xcheck_tag
-//      >,
-//      false
-//  >>(keyset, trie, bench_keyset);
+  Context context{keyset, trie, workloads, filter, thread_counts, scaling_workload, MakeWriterKeys(keyset), {}};
+
+  using namespace plain_da;
+  BenchmarkConstructionTypes<StatsPlainDaTrie, da_plus_operation_tag, false>("PlainDa+", context);
+  BenchmarkConstructionTypes<StatsPlainDaTrie, da_xor_operation_tag, false>("PlainDax", context);
+  BenchmarkConstructionTypes<StatsPlainDaMpTrie, da_plus_operation_tag, false>("MP+", context);
+  BenchmarkConstructionTypes<StatsPlainDaMpTrie, da_xor_operation_tag, false>("MPx", context);
+  BenchmarkConstructionTypes<StatsPlainDaTrie, da_plus_operation_tag, true>("PlainDa+", context);
+  BenchmarkConstructionTypes<StatsPlainDaTrie, da_xor_operation_tag, true>("PlainDax", context);
+  BenchmarkConstructionTypes<StatsPlainDaMpTrie, da_plus_operation_tag, true>("MP+", context);
+  BenchmarkConstructionTypes<StatsPlainDaMpTrie, da_xor_operation_tag, true>("MPx", context);
+  Benchmark<StatsPlainDaMpTrie<DoubleArrayBase<da_plus_operation_tag, ELM_xcheck_tag, cache_line_placement_tag>, false>>(
+      "MP+ ELM cache-line placement", context);
+  Benchmark<StatsPlainDaMpTrie<DoubleArrayBase<da_xor_operation_tag, WW_xcheck_tag, cache_line_placement_tag>, false>>(
+      "MPx WW cache-line placement", context);
+  Benchmark<CompactDaMpTrie>("Compact (frozen MPx)", context);
+
+  if (!json_path.empty()) {
+    std::ofstream ofs(json_path);
+    WriteJson(ofs, argv[1], context);
+  }
 
   return 0;
 }
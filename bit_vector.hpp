@@ -2,12 +2,18 @@
 #define PLAIN_DA_TRIES__BIT_VECTOR_HPP_
 
 #include <cstdint>
+#include <cassert>
 #include <vector>
+#include <algorithm>
+
+#include <bo.hpp>
+
+#include "image.hpp"
 
 namespace plain_da {
 
-class BitVector : private std::vector<uint64_t> {
-  using _base = std::vector<uint64_t>;
+class BitVector : private MappableVector<uint64_t> {
+  using _base = MappableVector<uint64_t>;
 
  private:
   size_t size_;
@@ -20,6 +26,10 @@ class BitVector : private std::vector<uint64_t> {
     return size_;
   }
 
+  size_t size_in_bytes() const {
+    return _base::size_in_bytes();
+  }
+
   void resize(size_t new_size) {
     _base::resize(new_size > 0 ? (new_size-1)/64+1 : 0);
     size_ = new_size;
@@ -28,6 +38,17 @@ class BitVector : private std::vector<uint64_t> {
   const uint64_t* data() const { return _base::data(); }
   uint64_t* data() { return _base::data(); }
 
+  void Write(ImageWriter& writer) const {
+    writer.WriteValue<uint64_t>(size_);
+    writer.WriteVector<uint64_t>(*this);
+  }
+
+  void Map(ImageReader& reader) {
+    size_ = reader.ReadValue<uint64_t>();
+    reader.MapVector<uint64_t>(*this);
+    CheckImageSection(_base::size() == (size_ + 63) / 64, "bits");
+  }
+
   uint64_t word(size_t wi) const {
     return wi < _base::size() ? _base::operator[](wi) : 0ull;
   }
@@ -207,6 +228,130 @@ class BitVector : private std::vector<uint64_t> {
 
 };
 
+
+// BitVector supporting rank and select in constant and logarithmic time respectively.
+// Ranks are kept absolute for each superblock and relative to the superblock for each block,
+// so that set updates the blocks of a single superblock and the superblocks, not every following block.
+class SuccinctBitVector {
+ public:
+  static constexpr size_t kBlockBits = 512;
+  static constexpr size_t kBlockWords = kBlockBits / 64;
+  static constexpr size_t kSuperBlockBits = 1 << 16;
+  static constexpr size_t kBlocksPerSuperBlock = kSuperBlockBits / kBlockBits;
+
+ private:
+  BitVector bits_;
+  // Ranks of superblocks followed by the number of ones.
+  MappableVector<uint32_t> super_ranks_;
+  // Ranks of blocks in their superblocks, including the block at the end of bits.
+  MappableVector<uint16_t> block_ranks_;
+
+ public:
+  SuccinctBitVector() = default;
+  explicit SuccinctBitVector(BitVector&& bits) : bits_(std::move(bits)) {
+    size_t num_blocks = (bits_.size() + kBlockBits - 1) / kBlockBits;
+    block_ranks_.assign(num_blocks + 1, 0);
+    super_ranks_.assign(num_blocks / kBlocksPerSuperBlock + 2, 0);
+    uint32_t sum = 0;
+    for (size_t b = 0; b <= num_blocks; b++) {
+      if (b % kBlocksPerSuperBlock == 0)
+        super_ranks_[b / kBlocksPerSuperBlock] = sum;
+      block_ranks_[b] = sum - super_ranks_[b / kBlocksPerSuperBlock];
+      for (size_t w = b * kBlockWords; w < (b + 1) * kBlockWords; w++)
+        sum += bo::popcnt_u64(bits_.word(w));
+    }
+    super_ranks_.back() = sum;
+  }
+
+  size_t size() const { return bits_.size(); }
+
+  size_t size_in_bytes() const {
+    return bits_.size_in_bytes() + super_ranks_.size_in_bytes() + block_ranks_.size_in_bytes();
+  }
+
+  void Write(ImageWriter& writer) const {
+    bits_.Write(writer);
+    writer.WriteVector(super_ranks_);
+    writer.WriteVector(block_ranks_);
+  }
+
+  void Map(ImageReader& reader) {
+    bits_.Map(reader);
+    reader.MapVector(super_ranks_);
+    reader.MapVector(block_ranks_);
+    auto num_blocks = (bits_.size() + kBlockBits - 1) / kBlockBits;
+    bool built = block_ranks_.size() == num_blocks + 1 and
+        super_ranks_.size() == num_blocks / kBlocksPerSuperBlock + 2 and super_ranks_.back() <= bits_.size();
+    CheckImageSection(built or (bits_.size() == 0 and super_ranks_.empty() and block_ranks_.empty()), "ranks");
+  }
+
+  // Number of ones in whole bits.
+  size_t num_ones() const {
+    return super_ranks_.empty() ? 0 : super_ranks_.back();
+  }
+
+  bool operator[](size_t pos) const {
+    return bits_[pos];
+  }
+
+  void set(size_t pos, bool bit) {
+    if (bits_[pos] == bit)
+      return;
+    bits_[pos] = bit;
+    auto block = pos / kBlockBits;
+    auto super = block / kBlocksPerSuperBlock;
+    auto super_end = std::min((super + 1) * kBlocksPerSuperBlock, block_ranks_.size());
+    for (size_t b = block + 1; b < super_end; b++)
+      block_ranks_[b] += bit ? 1 : -1;
+    for (size_t s = super + 1; s < super_ranks_.size(); s++)
+      super_ranks_[s] += bit ? 1 : -1;
+  }
+
+  // Extend with zeros.
+  void resize(size_t new_size) {
+    assert(new_size >= size());
+    auto ones = num_ones();
+    auto old_blocks = block_ranks_.size();
+    bits_.resize(new_size);
+    size_t num_blocks = (new_size + kBlockBits - 1) / kBlockBits;
+    super_ranks_.resize(num_blocks / kBlocksPerSuperBlock + 2, ones);
+    block_ranks_.resize(num_blocks + 1);
+    for (size_t b = old_blocks; b <= num_blocks; b++)
+      block_ranks_[b] = ones - super_ranks_[b / kBlocksPerSuperBlock];
+  }
+
+  // Number of ones in [0, pos).
+  size_t rank(size_t pos) const {
+    auto block = pos / kBlockBits;
+    size_t r = super_ranks_[block / kBlocksPerSuperBlock] + block_ranks_[block];
+    auto w = block * kBlockWords;
+    for (; w < pos / 64; w++)
+      r += bo::popcnt_u64(bits_.word(w));
+    if (pos % 64)
+      r += bo::popcnt_u64(bits_.word(w) & ((1ull << (pos % 64)) - 1));
+    return r;
+  }
+
+  // Position of (k+1)-th one.
+  size_t select(size_t k) const {
+    assert(k < num_ones());
+    auto super = std::upper_bound(super_ranks_.begin(), super_ranks_.end(), (uint32_t) k) - super_ranks_.begin() - 1;
+    k -= super_ranks_[super];
+    auto first = block_ranks_.begin() + super * kBlocksPerSuperBlock;
+    auto last = block_ranks_.begin() + std::min((super + 1) * kBlocksPerSuperBlock, block_ranks_.size());
+    auto block = std::upper_bound(first, last, (uint16_t) k) - block_ranks_.begin() - 1;
+    k -= block_ranks_[block];
+    auto w = block * kBlockWords;
+    for (;; w++) {
+      auto cnt = bo::popcnt_u64(bits_.word(w));
+      if (k < cnt)
+        break;
+      k -= cnt;
+    }
+    return w * 64 + bo::select_u64(bits_.word(w), k);
+  }
+};
+
 }
 
 #endif //PLAIN_DA_TRIES__BIT_VECTOR_HPP_
@@ -0,0 +1,76 @@
+#include "bit_vector.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Spanning a few superblocks so that updates cross them.
+constexpr size_t NumBits = 5 * plain_da::SuccinctBitVector::kSuperBlockBits + 100;
+constexpr size_t GrownBits = NumBits + 3 * plain_da::SuccinctBitVector::kSuperBlockBits;
+constexpr int NumUpdates = 20000;
+
+// rank and select agree with the plain bits after each phase.
+bool Verify(const plain_da::SuccinctBitVector& bv, const std::vector<bool>& bits) {
+  size_t ones = 0;
+  std::vector<size_t> positions;
+  for (size_t i = 0; i < bits.size(); i++) {
+    if (bv.rank(i) != ones) {
+      std::cout << "Test failed: rank(" << i << ") = " << bv.rank(i) << " != " << ones << std::endl;
+      return false;
+    }
+    if (bits[i]) {
+      positions.push_back(i);
+      ones++;
+    }
+  }
+  if (bv.num_ones() != ones or bv.rank(bits.size()) != ones) {
+    std::cout << "Test failed: num_ones() = " << bv.num_ones() << " != " << ones << std::endl;
+    return false;
+  }
+  for (size_t k = 0; k < positions.size(); k++) {
+    if (bv.select(k) != positions[k]) {
+      std::cout << "Test failed: select(" << k << ") = " << bv.select(k) << " != " << positions[k] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+int main() {
+  std::cout << "Test SuccinctBitVector..." << std::endl;
+  std::mt19937 gen(0);
+  std::vector<bool> bits(NumBits);
+  plain_da::BitVector raw(NumBits);
+  for (size_t i = 0; i < NumBits; i++)
+    raw[i] = bits[i] = gen() % 3 == 0;
+  plain_da::SuccinctBitVector bv(std::move(raw));
+  if (!Verify(bv, bits))
+    return 1;
+
+  for (int t = 0; t < NumUpdates; t++) {
+    size_t pos = gen() % NumBits;
+    bool bit = gen() % 2;
+    bv.set(pos, bit);
+    bits[pos] = bit;
+  }
+  if (!Verify(bv, bits))
+    return 1;
+
+  bv.resize(GrownBits);
+  bits.resize(GrownBits);
+  for (int t = 0; t < NumUpdates; t++) {
+    size_t pos = gen() % GrownBits;
+    bool bit = gen() % 2;
+    bv.set(pos, bit);
+    bits[pos] = bit;
+  }
+  if (!Verify(bv, bits))
+    return 1;
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
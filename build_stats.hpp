@@ -0,0 +1,139 @@
+#ifndef PLAIN_DA_TRIES__BUILD_STATS_HPP_
+#define PLAIN_DA_TRIES__BUILD_STATS_HPP_
+
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <ostream>
+
+#include "definition.hpp"
+#include "double_array_base.hpp"
+
+namespace plain_da {
+
+// Policies of the tries on statistics of construction, given as the StatsType of PlainDaTrie/PlainDaMpTrie.
+// NoBuildStats, the default, neither reads timers nor counts. BuildStats collects the statistics.
+struct NoBuildStats {
+  void Clear() {}
+
+  template <typename DaType, typename Container>
+  index_type FindBase(const DaType& bc, const Container& children, index_type parent) {
+    return bc.FindBase(children, nullptr, parent);
+  }
+
+  template <typename DaType>
+  void Finish(const DaType&, size_t) {}
+
+  void Print(std::ostream&) const {}
+};
+
+struct BuildStats {
+  // Bucket k of the histogram counts the calls given (2^(k-1), 2^k] children, that is 1, 2, 3-4, ..., 129-256.
+  static constexpr size_t kNumChildrenBuckets = 9;
+  // Bin b of each bucket counts the calls taking [2^b, 2^(b+1)) ns, and bin 0 also the calls taking 0 ns.
+  // The last bin also counts the longer calls.
+  static constexpr size_t kNumHistogramBins = 48;
+
+  size_t num_find_base = 0;
+  // Number of candidate bases rejected by FindBase.
+  size_t num_skips = 0;
+  uint64_t find_base_nanos = 0;
+  std::array<std::array<size_t, kNumHistogramBins>, kNumChildrenBuckets> find_base_histogram{};
+  size_t array_size = 0;
+  size_t num_enabled_units = 0;
+  size_t tail_size = 0;
+
+  double fill_ratio() const {
+    return array_size == 0 ? 0 : (double) num_enabled_units / array_size;
+  }
+
+  static size_t children_bucket(size_t num_children) {
+    return num_children <= 1 ? 0 : std::min<size_t>(64 - bo::clz_u64(num_children - 1), kNumChildrenBuckets - 1);
+  }
+
+  static size_t histogram_bin(uint64_t nanos) {
+    return nanos == 0 ? 0 : std::min<size_t>(63 - bo::clz_u64(nanos), kNumHistogramBins - 1);
+  }
+
+  // Number of the calls given the number of children in the bucket.
+  size_t num_find_base_in(size_t bucket) const {
+    auto& bins = find_base_histogram[bucket];
+    return std::accumulate(bins.begin(), bins.end(), size_t(0));
+  }
+
+  // Upper bound of the time of FindBase which the ratio of the calls take at most, by the histogram.
+  uint64_t find_base_nanos_quantile(double ratio) const {
+    std::array<size_t, kNumHistogramBins> bins{};
+    for (auto& bucket_bins : find_base_histogram) {
+      for (size_t b = 0; b < kNumHistogramBins; b++)
+        bins[b] += bucket_bins[b];
+    }
+    return _quantile(bins, num_find_base, ratio);
+  }
+  // The same of the calls given the number of children in the bucket.
+  uint64_t find_base_nanos_quantile(size_t bucket, double ratio) const {
+    return _quantile(find_base_histogram[bucket], num_find_base_in(bucket), ratio);
+  }
+
+  void Clear() {
+    *this = BuildStats();
+  }
+
+  // FindBase of bc recording the call.
+  template <typename DaType, typename Container>
+  index_type FindBase(const DaType& bc, const Container& children, index_type parent) {
+    auto start = std::chrono::steady_clock::now();
+    auto base = bc.FindBase(children, &num_skips, parent);
+    auto end = std::chrono::steady_clock::now();
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    num_find_base++;
+    find_base_nanos += nanos;
+    find_base_histogram[children_bucket(children.size())][histogram_bin(nanos)]++;
+    return base;
+  }
+
+  // Record the sizes of the constructed arrays.
+  template <typename DaType>
+  void Finish(const DaType& bc, size_t tail_bytes) {
+    array_size = bc.size();
+    num_enabled_units = bc.num_enabled_units();
+    tail_size = tail_bytes;
+  }
+
+  void Print(std::ostream& os) const {
+    os << "\tFindBase calls: " << num_find_base << std::endl;
+    os << "\tFindBase skips: " << num_skips << std::endl;
+    os << "\tFindBase time: " << (double) find_base_nanos / 1000000000 << " s (median <= "
+       << find_base_nanos_quantile(0.5) << " ns, p99 <= " << find_base_nanos_quantile(0.99) << " ns)" << std::endl;
+    for (size_t k = 0; k < kNumChildrenBuckets; k++) {
+      auto calls = num_find_base_in(k);
+      if (calls == 0)
+        continue;
+      size_t low = k == 0 ? 1 : (size_t(1) << (k - 1)) + 1, high = size_t(1) << k;
+      os << "\t\t" << low;
+      if (high > low)
+        os << "-" << high;
+      os << " children: " << calls << " calls (median <= " << find_base_nanos_quantile(k, 0.5)
+         << " ns, p99 <= " << find_base_nanos_quantile(k, 0.99) << " ns)" << std::endl;
+    }
+    os << "\tArray size: " << array_size << " (fill ratio " << fill_ratio() << ")" << std::endl;
+    os << "\tTail size: " << tail_size << std::endl;
+  }
+
+ private:
+  static uint64_t _quantile(const std::array<size_t, kNumHistogramBins>& bins, size_t num_calls, double ratio) {
+    size_t count = 0;
+    for (size_t b = 0; b < kNumHistogramBins; b++) {
+      count += bins[b];
+      if (count > 0 and count >= ratio * num_calls)
+        return uint64_t(1) << (b + 1);
+    }
+    return 0;
+  }
+};
+
+}
+
+#endif //PLAIN_DA_TRIES__BUILD_STATS_HPP_
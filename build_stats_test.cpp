@@ -0,0 +1,123 @@
+#include "build_stats.hpp"
+
+#include <iostream>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "plain_da.hpp"
+#include "keyset.hpp"
+#include "test_keyset.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 4000;
+
+// BuildStats also recording the number of children given to each call of FindBase.
+struct RecordingStats : plain_da::BuildStats {
+  std::vector<size_t> num_children;
+
+  void Clear() {
+    *this = RecordingStats();
+  }
+
+  template <typename DaType, typename Container>
+  plain_da::index_type FindBase(const DaType& bc, const Container& children, plain_da::index_type parent) {
+    num_children.push_back(children.size());
+    return BuildStats::FindBase(bc, children, parent);
+  }
+};
+
+template <class Trie>
+bool Test(const std::string& name, const plain_da::KeysetHandler& keyset, bool has_tail) {
+  using plain_da::BuildStats;
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie trie(plain_da::RawTrie{keyset});
+  auto& stats = trie.build_stats();
+  if (stats.num_find_base == 0 or stats.num_find_base != stats.num_children.size()) {
+    std::cout << "Test failed: FindBase calls are not counted" << std::endl;
+    return false;
+  }
+  std::array<size_t, BuildStats::kNumChildrenBuckets> expected{};
+  for (auto n : stats.num_children)
+    expected[BuildStats::children_bucket(n)]++;
+  size_t sum = 0;
+  for (size_t k = 0; k < BuildStats::kNumChildrenBuckets; k++) {
+    if (stats.num_find_base_in(k) != expected[k]) {
+      std::cout << "Test failed: " << stats.num_find_base_in(k) << " calls in bucket " << k
+                << " instead of " << expected[k] << std::endl;
+      return false;
+    }
+    sum += stats.num_find_base_in(k);
+    if (expected[k] == 0)
+      continue;
+    auto median = stats.find_base_nanos_quantile(k, 0.5);
+    auto p99 = stats.find_base_nanos_quantile(k, 0.99);
+    if (median == 0 or median > p99 or p99 > 2 * std::max<uint64_t>(stats.find_base_nanos, 1)) {
+      std::cout << "Test failed: bucket " << k << " median = " << median << " ns, p99 = " << p99 << " ns" << std::endl;
+      return false;
+    }
+  }
+  if (sum != stats.num_find_base) {
+    std::cout << "Test failed: buckets count " << sum << " calls of " << stats.num_find_base << std::endl;
+    return false;
+  }
+  // Keys of 'a'-'f' give 1 to 6 children.
+  if (expected[0] == 0 or expected[1] == 0 or expected[2] == 0) {
+    std::cout << "Test failed: keys do not cover the buckets of 1, 2 and 3-4 children" << std::endl;
+    return false;
+  }
+  auto median = stats.find_base_nanos_quantile(0.5);
+  auto p99 = stats.find_base_nanos_quantile(0.99);
+  if (median == 0 or median > p99 or p99 > 2 * std::max<uint64_t>(stats.find_base_nanos, 1)) {
+    std::cout << "Test failed: median = " << median << " ns, p99 = " << p99 << " ns" << std::endl;
+    return false;
+  }
+  if (stats.array_size != trie.size() or stats.fill_ratio() <= 0 or stats.fill_ratio() > 1) {
+    std::cout << "Test failed: array_size = " << stats.array_size << ", fill_ratio = " << stats.fill_ratio() << std::endl;
+    return false;
+  }
+  if (has_tail != (stats.tail_size > 0)) {
+    std::cout << "Test failed: tail_size = " << stats.tail_size << std::endl;
+    return false;
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+bool TestChildrenBuckets() {
+  using plain_da::BuildStats;
+  std::cout << "Test BuildStats children buckets..." << std::endl;
+  if (BuildStats::children_bucket(1) != 0 or BuildStats::children_bucket(2) != 1 or
+      BuildStats::children_bucket(3) != 2 or BuildStats::children_bucket(4) != 2 or
+      BuildStats::children_bucket(5) != 3 or BuildStats::children_bucket(128) != 7 or
+      BuildStats::children_bucket(129) != 8 or BuildStats::children_bucket(256) != 8) {
+    std::cout << "Test failed: children buckets are not 1, 2, 3-4, ..., 129-256" << std::endl;
+    return false;
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+}
+
+int main() {
+  auto keyset = plain_da::MakeTestKeyset(plain_da::MakeTestKeys(NumKeys, 0));
+
+  using namespace plain_da;
+  // Tries collect no stats unless BuildStats is given.
+  static_assert(std::is_same_v<std::decay_t<decltype(PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>().build_stats())>,
+                               NoBuildStats>);
+  bool ok = true;
+  ok &= TestChildrenBuckets();
+  ok &= Test<PlainDaTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false, RecordingStats>>("BuildStats PlainDa+ ELM", keyset, false);
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, CNV_xcheck_tag>, false, RecordingStats>>("BuildStats MP+ CNV", keyset, true);
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false, RecordingStats>>("BuildStats MPx WW", keyset, true);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+#ifndef PLAIN_DA_TRIES__COMPACT_DA_HPP_
+#define PLAIN_DA_TRIES__COMPACT_DA_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+#include "definition.hpp"
+#include "double_array_base.hpp"
+#include "tail.hpp"
+#include "keyset.hpp"
+#include "plain_da.hpp"
+
+namespace plain_da {
+
+// Read-only MP-trie frozen into 4-byte units in the manner of darts.
+// A unit is either a node
+//   | 0 | 0 | offset (20 bits) | extension (1 bit) | has_leaf (1 bit) | label (8 bits) |
+// a leaf node inlining the rest of the key of up to kMaxInlineLength characters
+//   | 0 | 1 | (4 bits) | length (2 bits) | characters (16 bits) | label (8 bits) |
+// or a value
+//   | 1 | TAIL index of the rest of the key, or 0 if the key ends here (31 bits) |
+// Children of the node at pos are placed at pos ^ offset ^ c and validated by their labels
+// instead of the index of the parent, which is enough since every base (pos ^ offset) is owned
+// by a single node. The value of a node having has_leaf is placed on the child labeled by kLeafChar,
+// so that kLeafChar in a query is rejected instead of followed.
+class CompactDaMpTrie {
+ public:
+  using unit_type = uint32_t;
+
+  static constexpr unit_type kValueFlag = 1u << 31;
+  static constexpr unit_type kInlineFlag = 1u << 30;
+  static constexpr unit_type kExtensionFlag = 1u << 9;
+  static constexpr unit_type kHasLeafFlag = 1u << 8;
+  static constexpr unit_type kLabelMask = 0xFF;
+  static constexpr unit_type kMaxPlainOffset = 1u << 20;
+  static constexpr unit_type kMaxExtendedOffset = 1u << 28;
+  static constexpr size_t kMaxInlineLength = 2;
+  // Number of last blocks searched for a base on construction.
+  static constexpr size_t kNumSearchBlocks = 16;
+
+ private:
+  std::vector<unit_type> units_;
+  Tail tail_;
+  size_t num_keys_ = 0;
+
+ public:
+  CompactDaMpTrie() = default;
+
+  template <typename DaType, bool EdgeOrdering, typename StatsType>
+  explicit CompactDaMpTrie(const PlainDaMpTrie<DaType, EdgeOrdering, StatsType>& trie) {
+    Build(trie);
+  }
+  template <typename DaType, bool EdgeOrdering, typename StatsType>
+  void Build(const PlainDaMpTrie<DaType, EdgeOrdering, StatsType>& trie);
+
+  explicit CompactDaMpTrie(const RawTrie& trie) {
+    Build(trie);
+  }
+  void Build(const RawTrie& trie) {
+    Build(PlainDaMpTrie<DoubleArrayBase<da_xor_operation_tag, ELM_xcheck_tag>, false>(trie));
+  }
+
+  size_t size() const { return units_.size(); }
+
+  size_t num_keys() const { return num_keys_; }
+
+  // Bytes of the arrays by component. Units left zero except the root are counted as wasted.
+  MemoryUsage memory_usage() const {
+    MemoryUsage usage;
+    usage.da_units = sizeof(unit_type) * units_.size();
+    if (!units_.empty())
+      usage.wasted = sizeof(unit_type) * std::count(units_.begin() + 1, units_.end(), 0);
+    usage.tail = tail_.size_in_bytes();
+    return usage;
+  }
+
+  size_t size_in_bytes() const { return memory_usage().total(); }
+
+  bool contains(std::string_view key) const {
+    index_type pos = 0;
+    auto unit = units_[pos];
+    for (size_t depth = 0; depth < key.size(); depth++) {
+      if (_is_inline(unit))
+        return _inline_equals(unit, key.substr(depth));
+      if (_has_leaf(unit)) {
+        auto value = _value(units_[pos ^ _offset(unit)]);
+        if (value != 0)
+          return _tail_equals(value, key.substr(depth));
+      }
+      // Label 0 is never a transition, but matches empty units.
+      if (key[depth] == kLeafChar)
+        return false;
+      pos ^= _offset(unit) ^ (uint8_t) key[depth];
+      unit = units_[pos];
+      if (_label(unit) != (uint8_t) key[depth])
+        return false;
+    }
+    if (_is_inline(unit))
+      return _inline_equals(unit, "");
+    if (!_has_leaf(unit))
+      return false;
+    auto value = _value(units_[pos ^ _offset(unit)]);
+    return value == 0 or _tail_equals(value, "");
+  }
+
+  // Lookup keys in [begin, end) and write results to out in order.
+  // Up to kBatchSize keys are traversed in lockstep so that their cache misses overlap.
+  template <typename InputIt, typename OutputIt>
+  OutputIt contains_batch(InputIt begin, InputIt end, OutputIt out) const {
+    std::string_view keys[kBatchSize];
+    bool results[kBatchSize];
+    while (begin != end) {
+      size_t n = 0;
+      for (; n < kBatchSize and begin != end; ++n, ++begin)
+        keys[n] = *begin;
+      _contains_batch(keys, n, results);
+      for (size_t i = 0; i < n; i++)
+        *out++ = results[i];
+    }
+    return out;
+  }
+
+ private:
+  static unit_type _label(unit_type unit) { return unit & (kValueFlag | kLabelMask); }
+  static bool _has_leaf(unit_type unit) { return unit & kHasLeafFlag; }
+  static index_type _offset(unit_type unit) { return (unit >> 10) << ((unit & kExtensionFlag) >> 6); }
+  static index_type _value(unit_type unit) { return unit & ~kValueFlag; }
+  static bool _is_inline(unit_type unit) { return unit & kInlineFlag; }
+
+  static unit_type _encode_inline(std::string_view suffix) {
+    assert(suffix.size() <= kMaxInlineLength);
+    unit_type unit = kInlineFlag | (unit_type) suffix.size() << 24;
+    for (size_t i = 0; i < suffix.size(); i++)
+      unit |= (unit_type) (uint8_t) suffix[i] << (8 + 8 * i);
+    return unit;
+  }
+  static bool _inline_equals(unit_type unit, std::string_view suffix) {
+    return _encode_inline_prefix(suffix) == (unit & ~kLabelMask);
+  }
+  // Same as _encode_inline if suffix fits, or never matches an inlined unit.
+  static unit_type _encode_inline_prefix(std::string_view suffix) {
+    return suffix.size() <= kMaxInlineLength ? _encode_inline(suffix) : 0;
+  }
+
+  static bool _encodable(unit_type offset) {
+    return offset < kMaxPlainOffset or (offset < kMaxExtendedOffset and (offset & kLabelMask) == 0);
+  }
+  static unit_type _encode_offset(unit_type offset) {
+    return offset < kMaxPlainOffset ? offset << 10 : (offset << 2) | kExtensionFlag;
+  }
+
+  bool _tail_equals(index_type tail_i, std::string_view suffix) const {
+    return tail_.label(tail_i) == suffix;
+  }
+
+  void _contains_batch(const std::string_view* keys, size_t n, bool* results) const {
+    index_type pos[kBatchSize];
+    size_t depth[kBatchSize];
+    size_t active[kBatchSize];
+    for (size_t i = 0; i < n; i++) {
+      pos[i] = 0;
+      depth[i] = 0;
+      active[i] = i;
+    }
+    size_t m = n;
+    while (m > 0) {
+      // Issue every transition (or value access) of this step before touching any of them.
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        auto unit = units_[pos[i]];
+        if (_is_inline(unit))
+          continue;
+        if (_has_leaf(unit))
+          __builtin_prefetch(units_.data() + (pos[i] ^ _offset(unit)));
+        if (depth[i] < keys[i].size())
+          __builtin_prefetch(units_.data() + (pos[i] ^ _offset(unit) ^ (uint8_t) keys[i][depth[i]]));
+      }
+      size_t k = 0;
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        auto unit = units_[pos[i]];
+        if (_is_inline(unit)) {
+          results[i] = _inline_equals(unit, keys[i].substr(depth[i]));
+          continue;
+        }
+        auto value = _has_leaf(unit) ? _value(units_[pos[i] ^ _offset(unit)]) : 0;
+        if (depth[i] == keys[i].size()) {
+          results[i] = _has_leaf(unit) and (value == 0 or _tail_equals(value, ""));
+        } else if (value != 0) {
+          results[i] = _tail_equals(value, keys[i].substr(depth[i]));
+        } else {
+          uint8_t c = keys[i][depth[i]];
+          pos[i] ^= _offset(unit) ^ c;
+          if (c == kLeafChar or _label(units_[pos[i]]) != c) {
+            results[i] = false;
+          } else {
+            depth[i]++;
+            active[k++] = i;
+          }
+        }
+      }
+      m = k;
+    }
+  }
+
+  // Find a base unused by other nodes whose positions of children are empty.
+  // Units before head are all placed since units are never removed on construction.
+  static index_type _find_base(const std::vector<unit_type>& units,
+                               const std::vector<bool>& used_bases,
+                               const std::vector<uint8_t>& children,
+                               index_type parent,
+                               size_t* head) {
+    auto empty = [&](size_t pos) { return pos != 0 and units[pos] == 0; };
+    size_t num_blocks = units.size() / kAlphabetSize;
+    if (num_blocks > kNumSearchBlocks)
+      *head = std::max(*head, (num_blocks - kNumSearchBlocks) * kAlphabetSize);
+    while (*head < units.size() and !empty(*head))
+      ++*head;
+    for (size_t pos = *head; pos < units.size(); pos++) {
+      if (!empty(pos))
+        continue;
+      index_type base = pos ^ children[0];
+      if (used_bases[base] or !_encodable(base ^ parent))
+        continue;
+      bool ok = std::all_of(children.begin()+1, children.end(), [&](uint8_t c) {
+        return empty(base ^ c);
+      });
+      if (ok)
+        return base;
+    }
+    // The labels of the offset to a new block are all zero.
+    return units.size() | (parent & kLabelMask);
+  }
+
+};
+
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void CompactDaMpTrie::Build(const PlainDaMpTrie<DaType, EdgeOrdering, StatsType>& trie) {
+  units_.assign(kAlphabetSize, 0);
+  tail_ = trie.tail_;
+  num_keys_ = 0;
+  if (trie.empty())
+    return;
+
+  std::vector<bool> used_bases(kAlphabetSize);
+  size_t head = 0;
+  // Every unit except the root is nonzero once it is placed.
+  std::vector<std::pair<index_type, index_type>> stack = {{0, 0}};
+  std::vector<uint8_t> children;
+  std::vector<index_type> sources;
+  while (!stack.empty()) {
+    auto [src, dst] = stack.back();
+    stack.pop_back();
+    auto& src_unit = trie.bc_[src];
+    children.clear();
+    sources.clear();
+    index_type value = 0;
+    bool has_leaf = false;
+    if (!src_unit.HasBase() and trie.tail_.label(src_unit.tail_i()).size() <= kMaxInlineLength) {
+      // Short rest of the key is inlined in the unit instead of the value.
+      units_[dst] |= _encode_inline(trie.tail_.label(src_unit.tail_i()));
+      num_keys_++;
+      continue;
+    } else if (!src_unit.HasBase()) {
+      has_leaf = true;
+      value = src_unit.tail_i();
+      children.push_back(kLeafChar);
+      sources.push_back(kInvalidIndex);
+    } else {
+      if (src_unit.IsTerminal()) {
+        has_leaf = true;
+        children.push_back(kLeafChar);
+        sources.push_back(kInvalidIndex);
+      }
+      for (uint8_t c = trie.links_[src].child; trie._has_child(src); ) {
+        auto child = trie.bc_.Operate(src_unit.base(), c);
+        children.push_back(c);
+        sources.push_back(child);
+        c = trie.links_[child].sibling;
+        if (c == kLeafChar)
+          break;
+      }
+    }
+    if (children.empty())
+      continue;
+
+    auto base = _find_base(units_, used_bases, children, dst, &head);
+    auto last = base | (kAlphabetSize - 1);
+    if ((size_t) last >= units_.size()) {
+      units_.resize(last + 1, 0);
+      used_bases.resize(last + 1);
+    }
+    used_bases[base] = true;
+    unit_type offset = base ^ dst;
+    if (!_encodable(offset))
+      throw std::logic_error("CompactDaMpTrie: too large array to encode offsets.");
+    units_[dst] |= _encode_offset(offset) | (has_leaf ? kHasLeafFlag : 0);
+    for (size_t i = children.size(); i > 0; i--) {
+      auto c = children[i-1];
+      auto pos = base ^ c;
+      if (c == kLeafChar) {
+        units_[pos] = kValueFlag | value;
+        num_keys_++;
+      } else {
+        units_[pos] = c;
+        stack.emplace_back(sources[i-1], pos);
+      }
+    }
+  }
+  units_.shrink_to_fit();
+}
+
+}
+
+#endif //PLAIN_DA_TRIES__COMPACT_DA_HPP_
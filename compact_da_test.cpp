@@ -0,0 +1,125 @@
+#include "compact_da.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "plain_da.hpp"
+#include "keyset.hpp"
+#include "test_keyset.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 4000;
+constexpr int NumQueries = 4000;
+
+bool TestSearch(const plain_da::CompactDaMpTrie& trie,
+                const std::vector<std::string>& keys,
+                const std::vector<std::string>& queries) {
+  for (auto& key : keys) {
+    if (!trie.contains(key)) {
+      std::cout << "Test failed: " << key << " is not contained" << std::endl;
+      return false;
+    }
+  }
+  std::set<std::string> key_set(keys.begin(), keys.end());
+  std::vector<bool> expected;
+  for (auto& query : queries) {
+    bool ok = key_set.count(query);
+    if (trie.contains(query) != ok) {
+      std::cout << "Test failed: contains(" << query << ") != " << ok << std::endl;
+      return false;
+    }
+    expected.push_back(ok);
+  }
+  std::vector<bool> results;
+  trie.contains_batch(queries.begin(), queries.end(), std::back_inserter(results));
+  if (results != expected) {
+    std::cout << "Test failed: contains_batch differs from contains" << std::endl;
+    return false;
+  }
+  // Keys with an inserted NUL, which must not follow the label 0 of value units or empty units.
+  std::vector<std::string> nul_queries;
+  for (auto& key : keys) {
+    for (size_t depth = 0; depth <= key.size(); depth++) {
+      auto nul_query = key.substr(0, depth) + '\0';
+      nul_queries.push_back(nul_query);
+      for (char c = 'a'; c < 'a' + 6; c++)
+        nul_queries.push_back(nul_query + c + key.substr(depth));
+    }
+  }
+  for (auto& query : nul_queries) {
+    if (trie.contains(query)) {
+      std::cout << "Test failed: a key with NUL is contained" << std::endl;
+      return false;
+    }
+  }
+  results.clear();
+  trie.contains_batch(nul_queries.begin(), nul_queries.end(), std::back_inserter(results));
+  if (std::count(results.begin(), results.end(), true) != 0) {
+    std::cout << "Test failed: contains_batch contains a key with NUL" << std::endl;
+    return false;
+  }
+  if (trie.num_keys() != keys.size()) {
+    std::cout << "Test failed: num_keys() = " << trie.num_keys() << " != " << keys.size() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <class Trie>
+bool Test(const std::string& name, const std::vector<std::string>& keys, const std::vector<std::string>& queries) {
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie source(plain_da::RawTrie{plain_da::MakeTestKeyset(keys)});
+  if (!TestSearch(plain_da::CompactDaMpTrie(source), keys, queries))
+    return false;
+
+  // Frozen after the dynamic update
+  std::vector<std::string> remaining_keys;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (i % 3 == 0)
+      source.Erase(keys[i]);
+    else
+      remaining_keys.push_back(keys[i]);
+  }
+  if (!TestSearch(plain_da::CompactDaMpTrie(source), remaining_keys, queries))
+    return false;
+
+  // A single key is stored on the TAIL from the root.
+  plain_da::CompactDaMpTrie single;
+  Trie single_source;
+  single_source.Insert(keys[0]);
+  single.Build(single_source);
+  if (!TestSearch(single, {keys[0]}, queries))
+    return false;
+
+  // Suffixes of up to kMaxInlineLength characters are inlined, which NUL in queries must not extend.
+  std::vector<std::string> inlined_keys = {"x", "xa", "xab", "xb\x01", "y"};
+  Trie inlined_source;
+  for (auto& key : inlined_keys)
+    inlined_source.Insert(key);
+  if (!TestSearch(plain_da::CompactDaMpTrie(inlined_source), inlined_keys, queries))
+    return false;
+
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+}
+
+int main() {
+  auto keys = plain_da::MakeTestKeys(NumKeys, 0);
+  auto queries = plain_da::MakeTestKeys(NumQueries, 1);
+
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>("Compact from MP+ ELM", keys, queries);
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>("Compact from MPx WW", keys, queries);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#ifndef PLAIN_DA_TRIES__CONCURRENT_TRIE_HPP_
+#define PLAIN_DA_TRIES__CONCURRENT_TRIE_HPP_
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+#include "keyset.hpp"
+
+namespace plain_da {
+
+// Single-writer / multi-reader trie over published instances of Trie.
+// Readers never lock, and the instance they see is never changed. The writer applies each update to a copy of
+// the instance and publishes the copy (copy-on-write), which costs a copy of the arrays per update, so that
+// updates in bulk are to be applied together by write.
+// The old instance is freed after a grace period, once every reader which may still see it has left
+// (epoch-based reclamation), without blocking the writer.
+// Trie is required to be copyable and to provide Insert/Erase.
+template <typename Trie>
+class ConcurrentTrie {
+ public:
+  using trie_type = Trie;
+  static constexpr size_t kNumReadIndicators = 64;
+  static constexpr size_t kCacheLineSize = 64;
+
+ private:
+  // Readers arriving on each parity of the epoch. Padded to avoid false sharing between reader threads.
+  struct alignas(kCacheLineSize) ReadIndicator {
+    std::atomic<uint32_t> count{0};
+  };
+
+  std::atomic<trie_type*> current_;
+  alignas(kCacheLineSize) std::atomic<uint64_t> epoch_{0};
+  mutable ReadIndicator read_indicators_[2][kNumReadIndicators];
+  std::mutex writer_mutex_;
+  // Instances replaced by the writer, with the epochs they were retired on.
+  std::deque<std::pair<uint64_t, std::unique_ptr<trie_type>>> retired_;
+
+ public:
+  ConcurrentTrie() : current_(new trie_type) {}
+
+  explicit ConcurrentTrie(trie_type&& trie) : current_(new trie_type(std::move(trie))) {}
+
+  explicit ConcurrentTrie(const KeysetHandler& keyset) : current_(new trie_type(keyset)) {}
+
+  explicit ConcurrentTrie(const RawTrie& trie) : current_(new trie_type(trie)) {}
+
+  // Readers are required to have left.
+  ~ConcurrentTrie() {
+    delete current_.load();
+  }
+
+  ConcurrentTrie(const ConcurrentTrie&) = delete;
+  ConcurrentTrie& operator=(const ConcurrentTrie&) = delete;
+
+  // Call f with the published instance, and return its result.
+  // f must not keep references to the instance after return, as the instance may be freed then.
+  template <typename Function>
+  auto read(Function f) const {
+    auto& indicator = read_indicators_[epoch_.load(std::memory_order_seq_cst) & 1][_indicator_slot()];
+    indicator.count.fetch_add(1, std::memory_order_seq_cst);
+    struct Departure {
+      ReadIndicator& indicator;
+      ~Departure() { indicator.count.fetch_sub(1, std::memory_order_release); }
+    } departure{indicator};
+    return f(static_cast<const trie_type&>(*current_.load(std::memory_order_seq_cst)));
+  }
+
+  bool contains(std::string_view key) const {
+    return read([key](const trie_type& trie) { return trie.contains(key); });
+  }
+
+  std::optional<uint32_t> lookup(std::string_view key) const {
+    return read([key](const trie_type& trie) { return trie.lookup(key); });
+  }
+
+  size_t num_keys() const {
+    return read([](const trie_type& trie) { return trie.num_keys(); });
+  }
+
+  // Updates leaving the trie unchanged neither copy nor publish it.
+  bool Insert(std::string_view key) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (current_.load(std::memory_order_relaxed)->contains(key))
+      return false;
+    return _update_copy([key](trie_type& trie) { return trie.Insert(key); });
+  }
+
+  bool Erase(std::string_view key) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (!current_.load(std::memory_order_relaxed)->contains(key))
+      return false;
+    return _update_copy([key](trie_type& trie) { return trie.Erase(key); });
+  }
+
+  // Apply f to a copy of the instance and publish it, which lets f change the trie in any way (e.g. Relayout)
+  // and apply many updates for a single copy.
+  template <typename Function>
+  auto write(Function f) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return _update_copy(f);
+  }
+
+  // Free the retired instances, waiting for the readers which may still see them.
+  void Reclaim() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    while (!retired_.empty()) {
+      _reclaim();
+      if (!retired_.empty())
+        std::this_thread::yield();
+    }
+  }
+
+  // Number of instances waiting for their grace periods.
+  size_t num_retired() const { return retired_.size(); }
+
+ private:
+  static size_t _indicator_slot() {
+    thread_local size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id()) % kNumReadIndicators;
+    return slot;
+  }
+
+  bool _is_empty(int parity) const {
+    for (auto& indicator : read_indicators_[parity]) {
+      if (indicator.count.load(std::memory_order_seq_cst) != 0)
+        return false;
+    }
+    return true;
+  }
+
+  // The copy is dropped without publishing if f throws (e.g. on an invalid key).
+  template <typename Function>
+  auto _update_copy(Function f) {
+    auto copy = std::make_unique<trie_type>(*current_.load(std::memory_order_relaxed));
+    auto result = f(*copy);
+    auto old = current_.exchange(copy.release(), std::memory_order_seq_cst);
+    retired_.emplace_back(epoch_.load(std::memory_order_relaxed), old);
+    _reclaim();
+    return result;
+  }
+
+  // Advance the epoch while no reader is left on the parity the next epoch reuses, and free the instances
+  // retired two epochs before. A reader seeing a retired instance arrived before it was replaced,
+  // so that it keeps either of the two advances from passing until it leaves.
+  void _reclaim() {
+    for (int i = 0; i < 2 and !retired_.empty(); i++) {
+      auto epoch = epoch_.load(std::memory_order_relaxed);
+      if (!_is_empty((epoch + 1) & 1))
+        break;
+      epoch_.store(epoch + 1, std::memory_order_seq_cst);
+    }
+    auto epoch = epoch_.load(std::memory_order_relaxed);
+    while (!retired_.empty() and retired_.front().first + 2 <= epoch)
+      retired_.pop_front();
+  }
+
+};
+
+}
+
+#endif //PLAIN_DA_TRIES__CONCURRENT_TRIE_HPP_
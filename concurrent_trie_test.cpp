@@ -0,0 +1,97 @@
+#include "concurrent_trie.hpp"
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include "plain_da.hpp"
+#include "double_array_base.hpp"
+#include "test_keyset.hpp"
+
+namespace {
+
+constexpr int NumKeys = 2000;
+constexpr int NumReaders = 4;
+
+template <class Trie>
+bool Test(const std::string& name, const std::vector<std::string>& keys) {
+  std::cout << "Test " << name << "..." << std::endl;
+  // Stable keys are contained through the test, and the others are inserted and erased by the writer.
+  std::vector<std::string> stable_keys, updated_keys;
+  for (size_t i = 0; i < keys.size(); i++)
+    (i % 2 == 0 ? stable_keys : updated_keys).push_back(keys[i]);
+  plain_da::ConcurrentTrie<Trie> trie(plain_da::RawTrie{plain_da::MakeTestKeyset(stable_keys)});
+
+  std::atomic<bool> done = false;
+  std::atomic<bool> ok = true;
+  std::vector<std::thread> readers;
+  for (int t = 0; t < NumReaders; t++) {
+    readers.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      while (!done.load()) {
+        auto& key = stable_keys[gen() % stable_keys.size()];
+        if (!trie.contains(key) or !trie.lookup(key)) {
+          std::cout << "Test failed: " << key << " is not contained during update" << std::endl;
+          ok = false;
+        }
+        trie.contains(updated_keys[gen() % updated_keys.size()]);
+      }
+    });
+  }
+  for (auto& key : updated_keys) {
+    if (!trie.Insert(key))
+      ok = false;
+  }
+  bool all_inserted = trie.num_keys() == keys.size();
+  // Readers go on after an update rejecting its key.
+  try {
+    trie.Insert(std::string("\0", 1));
+    ok = false;
+  } catch (const std::invalid_argument&) {}
+  for (auto& key : updated_keys) {
+    if (!trie.Erase(key))
+      ok = false;
+  }
+  done = true;
+  for (auto& reader : readers)
+    reader.join();
+  trie.Reclaim();
+  if (trie.num_retired() != 0) {
+    std::cout << "Test failed: " << trie.num_retired() << " instances are not reclaimed" << std::endl;
+    return false;
+  }
+
+  if (!all_inserted or trie.num_keys() != stable_keys.size()) {
+    std::cout << "Test failed: num_keys() = " << trie.num_keys() << std::endl;
+    return false;
+  }
+  for (auto& key : updated_keys) {
+    if (trie.contains(key)) {
+      std::cout << "Test failed: erased " << key << " is contained" << std::endl;
+      return false;
+    }
+  }
+  if (!ok)
+    return false;
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+}
+
+int main() {
+  auto keys = plain_da::MakeTestKeys(NumKeys, 0);
+
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>("Concurrent MP+ ELM", keys);
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>("Concurrent MPx WW", keys);
+
+  return ok ? 0 : 1;
+}
@@ -101,19 +101,23 @@ void _ntt(ModuloNTT f[], size_t n) {
   if (n > 1<<23) {
     throw std::logic_error("Length of input array of NTT is too long.");
   }
-  static bool initialized = false;
-  static ModuloNTT es[kDivLim+1], ies[kDivLim+1];
-  if (!initialized) {
-    initialized = true;
-    es[kDivLim] = pow(kPrimitiveRoot, (kModNTT-1)>>kDivLim);
-    for (int i = kDivLim-1; i >= 0; i--) {
-      es[i] = es[i+1] * es[i+1];
-    }
-    ies[kDivLim] = es[kDivLim].inv();
-    for (int i = kDivLim-1; i >= 0; i--) {
-      ies[i] = ies[i+1] * ies[i+1];
+  // Initialized once even if the first calls run on several threads.
+  struct Roots {
+    ModuloNTT es[kDivLim+1], ies[kDivLim+1];
+    Roots() {
+      es[kDivLim] = pow(kPrimitiveRoot, (kModNTT-1)>>kDivLim);
+      for (int i = kDivLim-1; i >= 0; i--) {
+        es[i] = es[i+1] * es[i+1];
+      }
+      ies[kDivLim] = es[kDivLim].inv();
+      for (int i = kDivLim-1; i >= 0; i--) {
+        ies[i] = ies[i+1] * ies[i+1];
+      }
     }
-  }
+  };
+  static const Roots roots;
+  const auto& es = roots.es;
+  const auto& ies = roots.ies;
 
   bit_reverse(f, n);
   for (int s = 1; 1 << s <= n; s++) {
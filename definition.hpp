@@ -1,10 +1,16 @@
 #ifndef PLAIN_DA_TRIES__DEFINITION_HPP_
 #define PLAIN_DA_TRIES__DEFINITION_HPP_
 
+#include <cstdint>
+#include <cstddef>
+
 namespace plain_da {
 
 constexpr uint8_t kLeafChar = '\0';
 constexpr size_t kAlphabetSize = 1u << 8;
+constexpr size_t kBatchSize = 16;
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kPageSize = 4096;
 
 }
 
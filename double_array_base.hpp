@@ -2,8 +2,12 @@
 #define PLAIN_DA_TRIES__DOUBLE_ARRAY_BASE_HPP_
 
 #include <cstdint>
+#include <cstring>
+#include <cassert>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <functional>
 #include <type_traits>
 
 #include <bo.hpp>
@@ -11,6 +15,8 @@
 #include "definition.hpp"
 #include "bit_vector.hpp"
 #include "convolution.hpp"
+#include "image.hpp"
+#include "memory_usage.hpp"
 
 namespace plain_da {
 
@@ -58,23 +64,48 @@ struct WW_ELM_xcheck_tag : WW_xcheck_tag, ELM_xcheck_tag {};
 struct CNV_xcheck_tag {};
 struct CNV_ELM_xcheck_tag : CNV_xcheck_tag, ELM_xcheck_tag {};
 
+// Placement policies choosing among the bases found by the xcheck.
+struct first_fit_placement_tag {};
+// Prefer bases in the page of the parent keeping children in a cache line.
+struct cache_line_placement_tag {};
 
-template <typename OperationTag, typename ConstructionType>
+
+template <typename OperationTag, typename ConstructionType, typename PlacementTag = first_fit_placement_tag>
 class DoubleArrayBase {
  public:
   using op_type = DaOperation<OperationTag>;
 
   static constexpr bool kEnableBitVector = std::is_base_of_v<WW_xcheck_tag, ConstructionType>;
+  static constexpr bool kEnablePageCounts = std::is_same_v<PlacementTag, cache_line_placement_tag>;
+  static constexpr index_type kUnitsPerPage = kPageSize / (2 * sizeof(index_type));
+
+  // Identifiers of the template arguments recorded on images.
+  static constexpr uint32_t kOperationId = std::is_same_v<OperationTag, da_xor_operation_tag> ? 1 : 0;
+  static constexpr uint32_t kConstructionId =
+      std::is_same_v<ConstructionType, ELM_xcheck_tag> ? 0 :
+      std::is_same_v<ConstructionType, WW_xcheck_tag> ? 1 :
+      std::is_same_v<ConstructionType, WW_ELM_xcheck_tag> ? 2 :
+      std::is_same_v<ConstructionType, CNV_xcheck_tag> ? 3 : 4;
 
   class DaUnit {
    private:
+    // Flag on base_ of a node where a key terminates, instead of a child labeled by kLeafChar.
+    static constexpr index_type kTerminalBit = 1 << 30;
     index_type check_ = kInvalidIndex;
     index_type base_ = kInvalidIndex;
    public:
     index_type check() const { return check_; }
     void set_check(index_type nv) { check_ = nv; }
-    index_type base() const { return base_ - kAlphabetSize; }
-    void set_base(index_type nv) { base_ = nv + kAlphabetSize; }
+    index_type base() const { return (base_ & ~kTerminalBit) - kAlphabetSize; }
+    void set_base(index_type nv) {
+      assert(nv + kAlphabetSize < kTerminalBit);
+      base_ = (nv + kAlphabetSize) | (IsTerminal() ? kTerminalBit : 0);
+    }
+    bool IsTerminal() const { return base_ >= 0 and (base_ & kTerminalBit); }
+    void set_terminal(bool terminal) {
+      assert(HasBase());
+      base_ = terminal ? base_ | kTerminalBit : base_ & ~kTerminalBit;
+    }
     index_type succ() const { return -check_-1; }
     void set_succ(index_type nv) {
       check_ = -(nv+1);
@@ -93,12 +124,28 @@ class DoubleArrayBase {
 
  private:
   op_type operation_;
-  std::vector<DaUnit> bc_;
+  MappableVector<DaUnit> bc_;
   BitVector exists_bits_;
+  // Numbers of disabled units in each page, letting FindBaseNear skip pages too full for the children.
+  MappableVector<uint16_t> page_free_counts_;
   index_type empty_head_ = kInvalidIndex;
 
  public:
   size_t size() const { return bc_.size(); }
+
+  size_t num_enabled_units() const {
+    return std::count_if(bc_.begin(), bc_.end(), [](auto& unit) { return unit.Enabled(); });
+  }
+
+  // Bytes of the units, the exists bits and the page counts. Disabled units are counted as wasted.
+  MemoryUsage memory_usage() const {
+    MemoryUsage usage;
+    usage.da_units = bc_.size_in_bytes();
+    usage.exists_bits = exists_bits_.size_in_bytes();
+    usage.page_counts = page_free_counts_.size_in_bytes();
+    usage.wasted = sizeof(DaUnit) * (size() - num_enabled_units());
+    return usage;
+  }
   
   index_type Operate(index_type base, uint8_t c) const {
     return operation_(base, c);
@@ -114,14 +161,48 @@ class DoubleArrayBase {
     return bc_[i];
   }
 
+  void Prefetch(index_type pos) const {
+    if (0 <= pos and pos < (index_type) size())
+      __builtin_prefetch(bc_.data() + pos);
+  }
+
+  void Write(ImageWriter& writer) const {
+    writer.WriteValue(empty_head_);
+    writer.WriteVector(bc_);
+    exists_bits_.Write(writer);
+    writer.WriteVector(page_free_counts_);
+  }
+
+  void Map(ImageReader& reader) {
+    empty_head_ = reader.ReadValue<index_type>();
+    reader.MapVector(bc_);
+    exists_bits_.Map(reader);
+    CheckImageSection(empty_head_ == kInvalidIndex or (0 <= empty_head_ and empty_head_ < (index_type) bc_.size()),
+                      "empty list");
+    CheckImageSection(exists_bits_.size() == (kEnableBitVector ? bc_.size() : 0), "exists bits");
+    reader.MapVector(page_free_counts_);
+    auto num_pages = (bc_.size() + kUnitsPerPage - 1) / kUnitsPerPage;
+    CheckImageSection(page_free_counts_.empty() or page_free_counts_.size() == num_pages, "page counts");
+    // Images of the other placement policies have no counts.
+    if (kEnablePageCounts and page_free_counts_.empty() and num_pages > 0) {
+      page_free_counts_.assign(num_pages, 0);
+      for (size_t i = 0; i < bc_.size(); i++)
+        page_free_counts_[i / kUnitsPerPage] += !bc_[i].Enabled();
+    }
+  }
+
   void SetDisabled(index_type pos);
 
   void SetEnabled(index_type pos);
 
   void CheckExpand(index_type pos);
 
+  // Find a base whose positions of children are all empty.
+  // The parent of the children is the hint of the placement policy.
+  template <typename Container>
+  index_type FindBase(const Container& children, size_t* counter, index_type parent = kInvalidIndex) const;
   template <typename Container>
-  index_type FindBase(const Container& children, size_t* counter) const;
+  index_type FindBaseNear(const Container& children, index_type parent) const;
   template <typename Container>
   index_type FindBaseELM(const Container& children, size_t* counter) const;
   template <typename Container>
@@ -131,8 +212,8 @@ class DoubleArrayBase {
 
 };
 
-template <typename OperationTag, typename ConstructionType>
-void DoubleArrayBase<OperationTag, ConstructionType>::SetDisabled(index_type pos) {
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
+void DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::SetDisabled(index_type pos) {
   if (empty_head_ == kInvalidIndex) {
     empty_head_ = pos;
     bc_[pos].set_succ(pos);
@@ -147,27 +228,34 @@ void DoubleArrayBase<OperationTag, ConstructionType>::SetDisabled(index_type pos
   if constexpr (kEnableBitVector) {
     exists_bits_[pos] = false;
   }
+  if constexpr (kEnablePageCounts) {
+    page_free_counts_[pos / kUnitsPerPage]++;
+  }
 }
 
-template <typename OperationTag, typename ConstructionType>
-void DoubleArrayBase<OperationTag, ConstructionType>::SetEnabled(index_type pos) {
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
+void DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::SetEnabled(index_type pos) {
   assert(!bc_[pos].Enabled());
   auto succ_pos = bc_[pos].succ();
   if (pos == empty_head_) {
     empty_head_ = (succ_pos != pos) ? succ_pos : kInvalidIndex;
   }
   auto pred_pos = bc_[pos].pred();
-  bc_[pos].set_check(kInvalidIndex);
-  bc_[pos].set_base(kInvalidIndex);
   bc_[pred_pos].set_succ(succ_pos);
   bc_[succ_pos].set_pred(pred_pos);
+  bc_[pos].set_check(kInvalidIndex);
+  bc_[pos].set_base(kInvalidIndex);
   if constexpr (kEnableBitVector) {
     exists_bits_[pos] = true;
   }
+  if constexpr (kEnablePageCounts) {
+    assert(page_free_counts_[pos / kUnitsPerPage] > 0);
+    page_free_counts_[pos / kUnitsPerPage]--;
+  }
 }
 
-template <typename OperationTag, typename ConstructionType>
-void DoubleArrayBase<OperationTag, ConstructionType>::CheckExpand(index_type pos) {
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
+void DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::CheckExpand(index_type pos) {
   auto old_size = size();
   auto new_size = ((pos/256)+1)*256;
   if (new_size <= old_size)
@@ -176,21 +264,32 @@ void DoubleArrayBase<OperationTag, ConstructionType>::CheckExpand(index_type pos
   if constexpr (kEnableBitVector) {
     exists_bits_.resize(new_size);
   }
+  if constexpr (kEnablePageCounts) {
+    page_free_counts_.resize((new_size + kUnitsPerPage - 1) / kUnitsPerPage);
+  }
   for (auto i = old_size; i < new_size; i++) {
     SetDisabled(i);
   }
 }
 
 
-template <typename OperationTag, typename ConstructionType>
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
 template <typename Container>
-index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBase(const Container& children, size_t* counter) const {
+index_type DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::FindBase(const Container& children, size_t* counter, index_type parent) const {
 
   assert(!children.empty());
 
   if (empty_head_ == kInvalidIndex)
     return std::max(0, operation_.inv(size(), children[0]));
 
+  if constexpr (std::is_same_v<PlacementTag, cache_line_placement_tag>) {
+    if (parent != kInvalidIndex) {
+      auto base = FindBaseNear(children, parent);
+      if (base != kInvalidIndex)
+        return base;
+    }
+  }
+
   if constexpr (std::is_same_v<ConstructionType, ELM_xcheck_tag>) {
 
     return FindBaseELM(children, counter);
@@ -208,9 +307,67 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBase(const Conta
   throw std::bad_function_call();
 }
 
-template <typename OperationTag, typename ConstructionType>
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
 template <typename Container>
-index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseELM(const Container& children, size_t* counter) const {
+index_type DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::FindBaseNear(const Container& children, index_type parent) const {
+  // A transition to a child in the page of the parent does not miss the TLB,
+  // and children in a single cache line are touched by a single miss on lookup and on enumeration.
+  constexpr index_type kUnitsPerLine = kCacheLineSize / sizeof(DaUnit);
+  static_assert(kUnitsPerPage == kPageSize / sizeof(DaUnit) and kUnitsPerPage % 64 == 0);
+  index_type page_front = parent / kUnitsPerPage * kUnitsPerPage;
+  if (page_free_counts_[parent / kUnitsPerPage] < children.size())
+    return kInvalidIndex;
+  uint8_t fstc = children[0];
+  uint8_t endc = children.back();
+  auto in_line = [&](index_type base) {
+    return operation_(base, fstc) / kUnitsPerLine == operation_(base, endc) / kUnitsPerLine;
+  };
+  // Labels in different lines are never placed in a line by any base of xor.
+  bool fits_line = std::is_same_v<OperationTag, da_plus_operation_tag> ?
+      endc - fstc < kUnitsPerLine :
+      (fstc / kUnitsPerLine) == (endc / kUnitsPerLine);
+
+  index_type page_end = std::min<index_type>(page_front + kUnitsPerPage, size());
+  index_type found = kInvalidIndex;
+  // Whether the first child placed on the disabled unit at pos is the best in the page.
+  auto place_at = [&](index_type pos) {
+    auto base = operation_.inv(pos, fstc);
+    if (base < 0)
+      return false;
+    for (int i = 1; i < children.size(); i++) {
+      auto child = operation_(base, children[i]);
+      if (child < page_front or page_end <= child or bc_[child].Enabled())
+        return false;
+    }
+    if (!fits_line or in_line(base))
+      return true;
+    if (found == kInvalidIndex)
+      found = base;
+    return false;
+  };
+  if constexpr (kEnableBitVector) {
+    // Visit the disabled units of the page only.
+    for (index_type w = page_front / 64; w * 64 < page_end; w++) {
+      for (auto empties = ~exists_bits_.word(w); empties != 0ull; empties &= empties - 1) {
+        auto pos = w * 64 + (index_type) bo::ctz_u64(empties);
+        if (pos >= page_end)
+          break;
+        if (place_at(pos))
+          return operation_.inv(pos, fstc);
+      }
+    }
+  } else {
+    for (index_type pos = page_front; pos < page_end; pos++) {
+      if (!bc_[pos].Enabled() and place_at(pos))
+        return operation_.inv(pos, fstc);
+    }
+  }
+  return found;
+}
+
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
+template <typename Container>
+index_type DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::FindBaseELM(const Container& children, size_t* counter) const {
   uint8_t fstc = children[0];
 
   auto base_front = operation_.inv(empty_head_, fstc);
@@ -234,9 +391,9 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseELM(const Co
   return std::max(0, operation_.inv(size(), fstc));
 }
 
-template <typename OperationTag, typename ConstructionType>
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
 template <typename Container>
-index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseWW(const Container& children, size_t* counter) const {
+index_type DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::FindBaseWW(const Container& children, size_t* counter) const {
 
   if constexpr (std::is_same_v<OperationTag, da_plus_operation_tag>) {
 
@@ -262,7 +419,11 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseWW(const Con
 
         auto window_front = offset + fstc;
         uint64_t word_with_fstc = ~exists_bits_.bits64(window_front);
-        assert(word_with_fstc != 0ull);
+        if (word_with_fstc == 0ull) { // Only after the fallback below
+          offset += 64;
+          if (counter) (*counter)++;
+          continue;
+        }
         auto window_empty_tail = window_front + 63 - bo::clz_u64(word_with_fstc);
         if (window_empty_tail >= size())
           break;
@@ -270,8 +431,9 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseWW(const Con
         auto next_empty_pos = bc_[window_empty_tail].succ();
         if (next_empty_pos == empty_head_)
           break;
-        assert(next_empty_pos - window_front >= 64); // This is advantage over WW_xcheck_tag
-        offset = next_empty_pos - fstc;
+        // The empty list is ascending as long as units are only added, which is advantage over WW_xcheck_tag.
+        // Units disabled by the dynamic update are appended, so fall back to the next window then.
+        offset = std::max(next_empty_pos, window_front + 64) - fstc;
 
       }
       if (counter) (*counter)++;
@@ -285,26 +447,27 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseWW(const Con
     for (; b < bend; ++b) {
       std::array<uint64_t, 4> bits{};
       for (uint8_t c : children) {
-        static uint64_t exists_word[4];
+        uint64_t exists_word[4];
         std::memcpy(exists_word, exists_bits_.data()+(b*4), sizeof(uint64_t)*4);
+        // Permute the bits of position p to p^c by swapping the halves of each level of the set bits in c.
         if (c & (1<<0))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= ((exists_word[i] >> 1) & 0x5555555555555555ull) | ((exists_word[i] & 0x5555555555555555ull) << 1);
+            exists_word[i] = ((exists_word[i] >> 1) & 0x5555555555555555ull) | ((exists_word[i] & 0x5555555555555555ull) << 1);
         if (c & (1<<1))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= ((exists_word[i] >> 2) & 0x3333333333333333ull) | ((exists_word[i] & 0x3333333333333333ull) << 2);
+            exists_word[i] = ((exists_word[i] >> 2) & 0x3333333333333333ull) | ((exists_word[i] & 0x3333333333333333ull) << 2);
         if (c & (1<<2))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= ((exists_word[i] >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((exists_word[i] & 0x0F0F0F0F0F0F0F0Full) << 4);
+            exists_word[i] = ((exists_word[i] >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((exists_word[i] & 0x0F0F0F0F0F0F0F0Full) << 4);
         if (c & (1<<3))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= ((exists_word[i] >> 8) & 0x00FF00FF00FF00FFull) | ((exists_word[i] & 0x00FF00FF00FF00FFull) << 8);
+            exists_word[i] = ((exists_word[i] >> 8) & 0x00FF00FF00FF00FFull) | ((exists_word[i] & 0x00FF00FF00FF00FFull) << 8);
         if (c & (1<<4))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= ((exists_word[i] >> 16) & 0x0000FFFF0000FFFFull) | ((exists_word[i] & 0x0000FFFF0000FFFFull) << 16);
+            exists_word[i] = ((exists_word[i] >> 16) & 0x0000FFFF0000FFFFull) | ((exists_word[i] & 0x0000FFFF0000FFFFull) << 16);
         if (c & (1<<5))
           for (int i = 0; i < 4; i++)
-            exists_word[i] |= (exists_word[i] >> 32) | (exists_word[i] << 32);
+            exists_word[i] = (exists_word[i] >> 32) | (exists_word[i] << 32);
         if (c & (1<<6)) {
           std::swap(exists_word[0], exists_word[1]);
           std::swap(exists_word[2], exists_word[3]);
@@ -329,13 +492,13 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseWW(const Con
   }
 }
 
-template <typename OperationTag, typename ConstructionType>
+template <typename OperationTag, typename ConstructionType, typename PlacementTag>
 template <typename Container>
-index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseCNV(const Container& children, size_t* counter) const {
+index_type DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>::FindBaseCNV(const Container& children, size_t* counter) const {
 
   if (std::is_same_v<OperationTag, da_plus_operation_tag>) {
 
-    static convolution::ModuloNTT fda[kAlphabetSize*2], fch[kAlphabetSize*2];
+    convolution::ModuloNTT fda[kAlphabetSize*2], fch[kAlphabetSize*2];
 
     index_type fstc = children[0];
     index_type endc = children.back();
@@ -367,19 +530,22 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseCNV(const Co
       if constexpr (!std::is_base_of_v<ELM_xcheck_tag, ConstructionType>) {
         f += n - m + 1;
       } else {
+        index_type next;
         if (endi >= size() or
-            (f = operator[](endi).succ()) == empty_head_) {
+            (next = operator[](endi).succ()) == empty_head_) {
           break;
         }
+        // The empty list can be out of order after the dynamic update.
+        f = next > f ? next : f + n - m + 1;
       }
-      if (counter) counter++;
+      if (counter) (*counter)++;
     }
 
     return size();
 
   } else if (std::is_same_v<OperationTag, da_xor_operation_tag>) {
 
-    static index_type hda[kAlphabetSize], hch[kAlphabetSize];
+    index_type hda[kAlphabetSize], hch[kAlphabetSize];
 
     constexpr size_t n = kAlphabetSize;
     memset(hch, 0, sizeof(index_type) * n);
@@ -395,7 +561,7 @@ index_type DoubleArrayBase<OperationTag, ConstructionType>::FindBaseCNV(const Co
           return (index_type) f + i;
         }
       }
-      if (counter) counter++;
+      if (counter) (*counter)++;
     }
     return size();
 
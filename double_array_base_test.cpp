@@ -0,0 +1,83 @@
+#include "double_array_base.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "filled_array.hpp"
+
+namespace {
+
+constexpr size_t ArrayUnits = 1 << 12;
+constexpr int NumCalls = 1000;
+
+std::vector<uint8_t> MakeChildren(std::mt19937& gen) {
+  std::vector<uint8_t> children;
+  int k = 1 + gen() % 4;
+  while (children.size() < k) {
+    uint8_t c = 1 + gen() % 255;
+    if (std::find(children.begin(), children.end(), c) == children.end())
+      children.push_back(c);
+  }
+  std::sort(children.begin(), children.end());
+  return children;
+}
+
+// FindBase returns a base whose children are all empty or beyond the end of the array.
+// If exact, the base must be the least one, as the xor strategies scan the blocks in order.
+template <typename DaType>
+bool Test(const std::string& name, bool exact) {
+  std::cout << "Test FindBase " << name << "..." << std::endl;
+  std::mt19937 gen(0);
+  for (double fill_ratio : {0.5, 0.9, 0.99}) {
+    auto bc = plain_da::MakeFilledArray<DaType>(ArrayUnits, fill_ratio, gen);
+    for (int t = 0; t < NumCalls; t++) {
+      auto children = MakeChildren(gen);
+      auto base = bc.FindBase(children, nullptr);
+      auto empty = [&](plain_da::index_type base) {
+        return std::all_of(children.begin(), children.end(), [&](uint8_t c) {
+          auto pos = bc.Operate(base, c);
+          return pos >= 0 and (pos >= (plain_da::index_type) bc.size() or !bc[pos].Enabled());
+        });
+      };
+      if (!empty(base)) {
+        std::cout << "Test failed: children of base " << base << " are not empty" << std::endl;
+        return false;
+      }
+      if (!exact)
+        continue;
+      plain_da::index_type first = 0;
+      while (first < (plain_da::index_type) bc.size() and !empty(first))
+        first++;
+      if (base != first) {
+        std::cout << "Test failed: found base " << base << " instead of " << first << std::endl;
+        return false;
+      }
+    }
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+}
+
+int main() {
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<Da<da_plus_operation_tag, ELM_xcheck_tag>>("+ ELM", false);
+  ok &= Test<Da<da_plus_operation_tag, WW_xcheck_tag>>("+ WW", false);
+  ok &= Test<Da<da_plus_operation_tag, WW_ELM_xcheck_tag>>("+ WW_ELM", false);
+  ok &= Test<Da<da_plus_operation_tag, CNV_xcheck_tag>>("+ CNV", false);
+  ok &= Test<Da<da_plus_operation_tag, CNV_ELM_xcheck_tag>>("+ CNV_ELM", false);
+  ok &= Test<Da<da_xor_operation_tag, ELM_xcheck_tag>>("x ELM", false);
+  ok &= Test<Da<da_xor_operation_tag, WW_xcheck_tag>>("x WW", true);
+  ok &= Test<Da<da_xor_operation_tag, WW_ELM_xcheck_tag>>("x WW_ELM", true);
+  ok &= Test<Da<da_xor_operation_tag, CNV_xcheck_tag>>("x CNV", true);
+  ok &= Test<Da<da_xor_operation_tag, CNV_ELM_xcheck_tag>>("x CNV_ELM", true);
+
+  return ok ? 0 : 1;
+}
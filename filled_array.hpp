@@ -0,0 +1,28 @@
+#ifndef PLAIN_DA_TRIES__FILLED_ARRAY_HPP_
+#define PLAIN_DA_TRIES__FILLED_ARRAY_HPP_
+
+#include <random>
+
+#include "double_array_base.hpp"
+
+namespace plain_da {
+
+// Double array of num_units units each enabled with the probability fill_ratio, for tests and benchmarks of FindBase.
+// Enabled units are marked by check 0 and hold no base.
+template <typename DaType>
+DaType MakeFilledArray(size_t num_units, double fill_ratio, std::mt19937& gen) {
+  std::bernoulli_distribution enabled(fill_ratio);
+  DaType bc;
+  bc.CheckExpand(num_units - 1);
+  for (size_t i = 0; i < num_units; i++) {
+    if (enabled(gen)) {
+      bc.SetEnabled(i);
+      bc[i].set_check(0);
+    }
+  }
+  return bc;
+}
+
+}
+
+#endif //PLAIN_DA_TRIES__FILLED_ARRAY_HPP_
@@ -0,0 +1,145 @@
+#include "double_array_base.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "filled_array.hpp"
+
+// Benchmark of FindBase of each strategy on synthetic streams of child sets.
+// The array is filled at random to a fill ratio and FindBase is called without placing the children,
+// so that every call of a stream sees the same array.
+
+namespace {
+
+constexpr size_t ArrayUnits = 1 << 16;
+constexpr size_t DefaultNumCalls = 2000;
+// Streams are cut off after this time, since a call can scan the whole array.
+constexpr double MaxStreamSeconds = 0.2;
+constexpr size_t CallsPerClockCheck = 16;
+
+// Labels of children are drawn from [front, front + width).
+struct LabelSpread {
+  std::string name;
+  int front;
+  int width;
+};
+
+const LabelSpread LabelSpreads[] = {
+    {"lower", 'a', 26},
+    {"printable", ' ', 95},
+    {"full", 1, 255},
+};
+
+// Number of children, or 0 for the skewed distribution mostly of a few children.
+constexpr int FanOuts[] = {1, 2, 4, 8, 32, 128, 0};
+
+constexpr double FillRatios[] = {0.5, 0.8, 0.9, 0.95, 0.99};
+
+std::string FanOutName(int fan_out) {
+  return fan_out == 0 ? "skewed" : std::to_string(fan_out);
+}
+
+std::vector<std::vector<uint8_t>> MakeChildSets(size_t num_sets, int fan_out, const LabelSpread& spread, unsigned seed) {
+  std::mt19937 gen(seed);
+  // The probability of k children is proportional to 1/k^2.
+  std::vector<double> weights(spread.width);
+  for (int k = 1; k <= spread.width; k++)
+    weights[k-1] = 1.0 / ((double) k * k);
+  std::discrete_distribution<int> skewed(weights.begin(), weights.end());
+  std::vector<int> labels(spread.width);
+  std::iota(labels.begin(), labels.end(), spread.front);
+
+  std::vector<std::vector<uint8_t>> sets(num_sets);
+  for (auto& children : sets) {
+    int k = fan_out == 0 ? skewed(gen) + 1 : fan_out;
+    // Partial Fisher-Yates shuffle to draw k distinct labels.
+    for (int i = 0; i < k; i++)
+      std::swap(labels[i], labels[i + gen() % (spread.width - i)]);
+    children.assign(labels.begin(), labels.begin() + k);
+    std::sort(children.begin(), children.end());
+  }
+  return sets;
+}
+
+struct Result {
+  size_t num_calls;
+  double ns_per_call;
+  double skips_per_call;
+  // Mean position of the found bases relative to the size of the array. Bases beyond 1 expand the array.
+  double base_position;
+};
+
+template <typename DaType>
+Result Measure(const DaType& bc, const std::vector<std::vector<uint8_t>>& child_sets) {
+  size_t skips = 0;
+  double base_sum = 0;
+  size_t num_calls = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start;
+  while (num_calls < child_sets.size()) {
+    auto chunk_end = std::min(num_calls + CallsPerClockCheck, child_sets.size());
+    for (; num_calls < chunk_end; num_calls++)
+      base_sum += bc.FindBase(child_sets[num_calls], &skips);
+    end = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(end - start).count() > MaxStreamSeconds)
+      break;
+  }
+  Result result;
+  result.num_calls = num_calls;
+  result.ns_per_call = std::chrono::duration<double, std::nano>(end - start).count() / num_calls;
+  result.skips_per_call = (double) skips / num_calls;
+  result.base_position = base_sum / num_calls / bc.size();
+  return result;
+}
+
+template <typename OperationTag, typename ConstructionType>
+void Benchmark(const std::string& name, size_t num_calls) {
+  using da_type = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+  for (double fill_ratio : FillRatios) {
+    std::mt19937 gen(0);
+    auto bc = plain_da::MakeFilledArray<da_type>(ArrayUnits, fill_ratio, gen);
+    for (auto& spread : LabelSpreads) {
+      for (int fan_out : FanOuts) {
+        if (fan_out > spread.width)
+          continue;
+        auto child_sets = MakeChildSets(num_calls, fan_out, spread, 1);
+        auto result = Measure(bc, child_sets);
+        std::cout << name << "\t" << fill_ratio << "\t" << spread.name << "\t" << FanOutName(fan_out) << "\t"
+                  << result.num_calls << "\t" << result.ns_per_call << "\t" << result.skips_per_call << "\t"
+                  << result.base_position << std::endl;
+      }
+    }
+  }
+}
+
+template <typename OperationTag>
+void BenchmarkConstructionTypes(const std::string& name, size_t num_calls) {
+  using namespace plain_da;
+  Benchmark<OperationTag, ELM_xcheck_tag>(name + " ELM", num_calls);
+  Benchmark<OperationTag, WW_xcheck_tag>(name + " WW", num_calls);
+  Benchmark<OperationTag, WW_ELM_xcheck_tag>(name + " WW_ELM", num_calls);
+  Benchmark<OperationTag, CNV_xcheck_tag>(name + " CNV", num_calls);
+  Benchmark<OperationTag, CNV_ELM_xcheck_tag>(name + " CNV_ELM", num_calls);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_calls = argc > 1 ? std::stoull(argv[1]) : DefaultNumCalls;
+  if (num_calls == 0) {
+    std::cout << "Usage: " << argv[0] << " [number of FindBase calls per stream]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::cout << "strategy\tfill_ratio\tlabels\tfan_out\tcalls\tns/call\tskips/call\tbase_position" << std::endl;
+
+  using namespace plain_da;
+  BenchmarkConstructionTypes<da_plus_operation_tag>("+", num_calls);
+  BenchmarkConstructionTypes<da_xor_operation_tag>("x", num_calls);
+
+  return 0;
+}
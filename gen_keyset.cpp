@@ -0,0 +1,22 @@
+#include "keyset_generator.hpp"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0] << " [url|word|dna|numeric|path] [num_keys] [seed=0] > keyset" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  try {
+    auto shape = plain_da::ParseKeysetShape(argv[1]);
+    size_t num_keys = std::stoull(argv[2]);
+    uint64_t seed = argc > 3 ? std::stoull(argv[3]) : 0;
+    for (auto& key : plain_da::GenerateKeyset(shape, num_keys, seed))
+      std::cout << key << '\n';
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
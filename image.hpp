@@ -0,0 +1,307 @@
+#ifndef PLAIN_DA_TRIES__IMAGE_HPP_
+#define PLAIN_DA_TRIES__IMAGE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace plain_da {
+
+constexpr char kImageMagic[8] = "PLAINDA";
+constexpr uint32_t kImageVersion = 4;
+// Sections of an image are aligned so that arrays are directly mapped.
+constexpr size_t kImageAlignment = 8;
+
+// Vector either owns its elements or refers to the elements on a mapped image.
+// Mapped elements are privately mapped, so that modifications do not reach the file.
+// Operations changing the size copy the mapped elements to own them.
+template <typename T>
+class MappableVector {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+ private:
+  std::vector<T> vec_;
+  T* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  MappableVector() = default;
+  explicit MappableVector(size_t size, const T& value = T()) : vec_(size, value) { _sync(); }
+  MappableVector(std::vector<T>&& vec) : vec_(std::move(vec)) { _sync(); }
+
+  MappableVector(const MappableVector& rhs) : vec_(rhs.begin(), rhs.end()) { _sync(); }
+  MappableVector& operator=(const MappableVector& rhs) {
+    if (this != &rhs) {
+      vec_.assign(rhs.begin(), rhs.end());
+      _sync();
+    }
+    return *this;
+  }
+  MappableVector(MappableVector&& rhs) noexcept
+      : vec_(std::move(rhs.vec_)), data_(rhs.data_), size_(rhs.size_) {
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+  }
+  MappableVector& operator=(MappableVector&& rhs) noexcept {
+    vec_ = std::move(rhs.vec_);
+    data_ = rhs.data_;
+    size_ = rhs.size_;
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+    return *this;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t size_in_bytes() const { return sizeof(T) * size_; }
+  bool mapped() const { return data_ != vec_.data(); }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  T& operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T& back() { return data_[size_-1]; }
+  const T& back() const { return data_[size_-1]; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  void resize(size_t new_size, const T& value = T()) {
+    _own();
+    vec_.resize(new_size, value);
+    _sync();
+  }
+  void assign(size_t new_size, const T& value) {
+    vec_.assign(new_size, value);
+    _sync();
+  }
+  void push_back(const T& value) {
+    _own();
+    vec_.push_back(value);
+    _sync();
+  }
+  template <typename InputIt>
+  iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    auto offset = pos - begin();
+    _own();
+    vec_.insert(vec_.begin() + offset, first, last);
+    _sync();
+    return begin() + offset;
+  }
+  void shrink_to_fit() {
+    _own();
+    vec_.shrink_to_fit();
+    _sync();
+  }
+
+  // Refer to size elements placed at ptr on a mapped image.
+  void Map(T* ptr, size_t size) {
+    vec_ = {};
+    data_ = ptr;
+    size_ = size;
+  }
+
+ private:
+  void _sync() {
+    data_ = vec_.data();
+    size_ = vec_.size();
+  }
+
+  void _own() {
+    if (mapped() and data_ != nullptr) {
+      vec_.assign(data_, data_ + size_);
+      _sync();
+    }
+  }
+};
+
+// Read-only file mapped into memory by MAP_PRIVATE.
+class MappedFile {
+ private:
+  void* addr_ = MAP_FAILED;
+  size_t size_ = 0;
+
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to stat " + path);
+    }
+    size_ = st.st_size;
+    if (size_ > 0)
+      addr_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr_ == MAP_FAILED)
+      throw std::runtime_error("Failed to mmap " + path);
+  }
+  ~MappedFile() {
+    if (addr_ != MAP_FAILED)
+      ::munmap(addr_, size_);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  char* data() const { return static_cast<char*>(addr_); }
+  size_t size() const { return size_; }
+};
+
+// Sequential writer of an image.
+class ImageWriter {
+ private:
+  std::ostream& os_;
+  size_t offset_ = 0;
+
+ public:
+  explicit ImageWriter(std::ostream& os) : os_(os) {}
+
+  template <typename T>
+  void WriteValue(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    _write(&value, sizeof(T));
+  }
+
+  template <typename T>
+  void WriteArray(const T* data, size_t size) {
+    WriteValue<uint64_t>(size);
+    _write(data, sizeof(T) * size);
+  }
+
+  template <typename T>
+  void WriteVector(const MappableVector<T>& vec) {
+    WriteArray(vec.data(), vec.size());
+  }
+
+  // Throw if writing any section failed, e.g. on a full disk.
+  void Finish() {
+    os_.flush();
+    if (!os_)
+      throw std::runtime_error("Failed to write the image.");
+  }
+
+ private:
+  void _write(const void* data, size_t bytes) {
+    os_.write(static_cast<const char*>(data), bytes);
+    offset_ += bytes;
+    static const char kPadding[kImageAlignment] = {};
+    auto padding = (kImageAlignment - offset_ % kImageAlignment) % kImageAlignment;
+    os_.write(kPadding, padding);
+    offset_ += padding;
+  }
+};
+
+// Sequential reader of an image, mapping arrays without copy.
+class ImageReader {
+ private:
+  char* ptr_;
+  char* end_;
+
+ public:
+  ImageReader(char* data, size_t size) : ptr_(data), end_(data + size) {}
+
+  template <typename T>
+  T ReadValue() {
+    T value;
+    std::memcpy(&value, _read(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  T* MapArray(size_t* size) {
+    *size = ReadValue<uint64_t>();
+    if (*size > (size_t) (end_ - ptr_) / sizeof(T))
+      throw std::runtime_error("Broken image: array exceeds the image.");
+    return reinterpret_cast<T*>(_read(sizeof(T) * *size));
+  }
+
+  template <typename T>
+  void MapVector(MappableVector<T>& vec) {
+    size_t size;
+    auto ptr = MapArray<T>(&size);
+    vec.Map(ptr, size);
+  }
+
+  // Throw unless the sections read span the whole image.
+  void CheckEnd() const {
+    if (ptr_ != end_)
+      throw std::runtime_error("Broken image: sections do not match the size of the image.");
+  }
+
+ private:
+  char* _read(size_t bytes) {
+    auto aligned = (bytes + kImageAlignment - 1) / kImageAlignment * kImageAlignment;
+    if (aligned > (size_t) (end_ - ptr_))
+      throw std::runtime_error("Broken image: unexpected end of image.");
+    auto ret = ptr_;
+    ptr_ += aligned;
+    return ret;
+  }
+};
+
+// Throw unless the sizes of mapped sections are consistent with each other.
+inline void CheckImageSection(bool valid, const std::string& section) {
+  if (!valid)
+    throw std::runtime_error("Broken image: inconsistent " + section + ".");
+}
+
+struct ImageHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t trie_id;
+  uint32_t operation_id;
+  uint32_t construction_id;
+  uint32_t edge_ordering;
+  uint32_t unit_bytes;
+};
+
+// Header identifying the trie class and the template arguments of the double array.
+template <typename DaType>
+ImageHeader MakeImageHeader(uint32_t trie_id, bool edge_ordering) {
+  ImageHeader header{};
+  std::copy(std::begin(kImageMagic), std::end(kImageMagic), header.magic);
+  header.version = kImageVersion;
+  header.trie_id = trie_id;
+  header.operation_id = DaType::kOperationId;
+  header.construction_id = DaType::kConstructionId;
+  header.edge_ordering = edge_ordering;
+  header.unit_bytes = sizeof(typename DaType::DaUnit);
+  return header;
+}
+
+inline void CheckImageHeader(const ImageHeader& header, const ImageHeader& expected) {
+  if (!std::equal(std::begin(kImageMagic), std::end(kImageMagic), header.magic))
+    throw std::runtime_error("Not an image of plain-da-tries.");
+  if (header.version != expected.version)
+    throw std::runtime_error("Unsupported image version " + std::to_string(header.version) + ".");
+  if (header.trie_id != expected.trie_id or
+      header.operation_id != expected.operation_id or
+      header.construction_id != expected.construction_id or
+      header.edge_ordering != expected.edge_ordering or
+      header.unit_bytes != expected.unit_bytes)
+    throw std::runtime_error("Image is saved by another type of trie.");
+}
+
+}
+
+#endif //PLAIN_DA_TRIES__IMAGE_HPP_
@@ -4,9 +4,19 @@
 #include <cstdint>
 #include <vector>
 #include <string_view>
+#include <string>
+#include <istream>
+#include <stdexcept>
+#include <cassert>
 
 namespace plain_da {
 
+// Keys of the MP-tries are required not to contain '\0', which terminates labels on the TAIL and ends lists of links.
+inline void CheckKey(std::string_view key) {
+  if (key.find('\0') != std::string_view::npos)
+    throw std::invalid_argument("Keys are required not to contain '\\0'.");
+}
+
 class KeysetHandler {
  public:
   using value_type = std::string_view;
@@ -61,6 +71,7 @@ class KeysetHandler {
 };
 
 
+// The end of a key is an edge labeled by kLeafChar without next, so that '\0' in keys is an edge with next.
 class RawTrie {
  public:
   static constexpr uint8_t kLeafChar = '\0';
@@ -95,7 +106,7 @@ class RawTrie {
       }
 
       auto pit = keyit;
-      uint8_t pibot_char = kLeafChar;
+      int pibot_char = -1;
       while (keyit < end) {
         uint8_t c = (*keyit)[depth];
         if (pibot_char < c) {
@@ -132,6 +143,16 @@ class RawTrie {
 
 };
 
+// CheckKey for every key of trie.
+inline void CheckKeys(const RawTrie& trie) {
+  for (auto& edges : trie) {
+    for (auto e : edges) {
+      if (e.c == RawTrie::kLeafChar and e.next != -1)
+        throw std::invalid_argument("Keys are required not to contain '\\0'.");
+    }
+  }
+}
+
 }
 
 #endif //PLAIN_DA_TRIES__KEYSET_HPP_
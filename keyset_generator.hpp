@@ -0,0 +1,190 @@
+#ifndef PLAIN_DA_TRIES__KEYSET_GENERATOR_HPP_
+#define PLAIN_DA_TRIES__KEYSET_GENERATOR_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "keyset.hpp"
+
+namespace plain_da {
+
+// Shapes of synthetic keysets mimicking the datasets of the experiments.
+enum class KeysetShape {
+  // URLs sharing hosts and directories.
+  kUrl,
+  // Natural-language-like words of syllables.
+  kWord,
+  // DNA k-mers over ACGT of the fixed length kDnaKmerLength.
+  kDna,
+  // Decimal IDs clustered in sequential runs.
+  kNumeric,
+  // Deep file paths sharing long prefixes.
+  kPath,
+};
+
+constexpr std::string_view kKeysetShapeNames[] = {"url", "word", "dna", "numeric", "path"};
+constexpr size_t kDnaKmerLength = 31;
+constexpr size_t kMaxPathDepth = 12;
+
+inline KeysetShape ParseKeysetShape(std::string_view name) {
+  for (size_t i = 0; i < std::size(kKeysetShapeNames); i++) {
+    if (name == kKeysetShapeNames[i])
+      return KeysetShape(i);
+  }
+  throw std::invalid_argument("Unknown keyset shape " + std::string(name) + ".");
+}
+
+// Generator of sorted unique keys, deterministic for the seed on every platform.
+// Only the raw output of std::mt19937_64 is used since the standard distributions are implementation-defined,
+// and each expression draws at most once since the order of evaluating operands is unspecified.
+class KeysetGenerator {
+ private:
+  std::mt19937_64 gen_;
+
+ public:
+  explicit KeysetGenerator(uint64_t seed) : gen_(seed) {}
+
+  std::vector<std::string> Generate(KeysetShape shape, size_t num_keys) {
+    std::unordered_set<std::string> keys;
+    keys.reserve(num_keys);
+    // Shapes of small spaces (e.g. short words) may not have num_keys distinct keys.
+    size_t max_trials = num_keys * 64 + 1024;
+    uint64_t next_id = _uniform(1000000000);
+    std::vector<std::string> hosts, dirs;
+    for (size_t trial = 0; keys.size() < num_keys and trial < max_trials; trial++) {
+      switch (shape) {
+        case KeysetShape::kUrl:
+          keys.insert(_url(hosts, num_keys));
+          break;
+        case KeysetShape::kWord:
+          keys.insert(_word(1 + _skewed(4)));
+          break;
+        case KeysetShape::kDna:
+          keys.insert(_dna(kDnaKmerLength));
+          break;
+        case KeysetShape::kNumeric:
+          // Runs of consecutive IDs broken by random gaps.
+          next_id += _uniform(8) == 0 ? 1 + _uniform(1000000) : 1;
+          keys.insert(std::to_string(next_id));
+          break;
+        case KeysetShape::kPath:
+          keys.insert(_path(dirs, num_keys));
+          break;
+      }
+    }
+    if (keys.size() < num_keys)
+      throw std::invalid_argument("Too many keys for the keyset shape.");
+    std::vector<std::string> sorted(keys.begin(), keys.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+  }
+
+ private:
+  uint64_t _uniform(uint64_t n) {
+    return gen_() % n;
+  }
+
+  // Value in [0, n) where smaller values are more frequent, with probability about log(n/(x+1))/n.
+  uint64_t _skewed(uint64_t n) {
+    return _uniform(_uniform(n) + 1);
+  }
+
+  std::string _word(size_t num_syllables) {
+    static constexpr std::string_view kOnsets[] = {
+        "", "b", "c", "d", "f", "g", "h", "l", "m", "n", "p", "r", "s", "t", "v", "w",
+        "br", "ch", "cl", "cr", "dr", "fl", "gr", "pl", "pr", "sh", "st", "str", "th", "tr"};
+    static constexpr std::string_view kNuclei[] = {
+        "a", "e", "i", "o", "u", "ea", "ee", "ai", "ou", "io", "y"};
+    static constexpr std::string_view kCodas[] = {
+        "", "", "", "n", "r", "s", "t", "l", "m", "nd", "ng", "st", "ck", "ss"};
+    static constexpr std::string_view kSuffixes[] = {
+        "", "", "", "", "s", "ed", "ing", "er", "ly", "tion", "ness"};
+    std::string word;
+    for (size_t i = 0; i < num_syllables; i++) {
+      word += kOnsets[_skewed(std::size(kOnsets))];
+      word += kNuclei[_skewed(std::size(kNuclei))];
+      word += kCodas[_skewed(std::size(kCodas))];
+    }
+    word += kSuffixes[_uniform(std::size(kSuffixes))];
+    return word;
+  }
+
+  std::string _dna(size_t length) {
+    static constexpr char kBases[] = {'A', 'C', 'G', 'T'};
+    std::string kmer(length, 'A');
+    for (auto& c : kmer)
+      c = kBases[_uniform(4)];
+    return kmer;
+  }
+
+  // Pick from pool of about pool_size elements made by make, skewed to the elements made earlier.
+  template <typename Make>
+  std::string _pick(std::vector<std::string>& pool, size_t pool_size, Make make) {
+    if (pool.size() < pool_size and (pool.empty() or _uniform(4) == 0))
+      pool.push_back(make());
+    return pool[_skewed(pool.size())];
+  }
+
+  std::string _url(std::vector<std::string>& hosts, size_t num_keys) {
+    static constexpr std::string_view kSchemes[] = {"http://", "https://"};
+    static constexpr std::string_view kTlds[] = {".com", ".org", ".net", ".jp", ".de", ".co.uk", ".io"};
+    auto host = _pick(hosts, num_keys / 32 + 1, [&] {
+      std::string host(kSchemes[_uniform(std::size(kSchemes))]);
+      if (_uniform(2) == 0)
+        host += "www.";
+      host += _word(1 + _uniform(3));
+      return host + std::string(kTlds[_skewed(std::size(kTlds))]);
+    });
+    auto url = host;
+    for (size_t depth = _skewed(5); depth > 0; depth--)
+      url += "/" + _word(1 + _uniform(3));
+    if (_uniform(4) == 0)
+      url += "?id=" + std::to_string(_uniform(100000));
+    else if (_uniform(2) == 0)
+      url += "/";
+    return url;
+  }
+
+  std::string _path(std::vector<std::string>& dirs, size_t num_keys) {
+    static constexpr std::string_view kRoots[] = {
+        "/usr/share/", "/usr/lib/", "/home/user/projects/", "/var/lib/", "/opt/"};
+    static constexpr std::string_view kExtensions[] = {".txt", ".h", ".cpp", ".py", ".json", ".png", ".so", ""};
+    // Directories are nested in shared parents to make long common prefixes.
+    auto dir = _pick(dirs, num_keys / 8 + 1, [&] {
+      std::string dir = dirs.empty() or _uniform(8) == 0
+                        ? std::string(kRoots[_uniform(std::size(kRoots))])
+                        : dirs[_uniform(dirs.size())];
+      auto depth = 1 + _uniform(3);
+      if (std::count(dir.begin(), dir.end(), '/') + depth > kMaxPathDepth)
+        dir = kRoots[_uniform(std::size(kRoots))];
+      for (; depth > 0; depth--)
+        dir += _word(1 + _uniform(2)) + "/";
+      return dir;
+    });
+    auto path = dir + _word(1 + _uniform(3));
+    return path + std::string(kExtensions[_uniform(std::size(kExtensions))]);
+  }
+};
+
+// Sorted unique num_keys keys of shape generated by seed.
+inline std::vector<std::string> GenerateKeyset(KeysetShape shape, size_t num_keys, uint64_t seed) {
+  return KeysetGenerator(seed).Generate(shape, num_keys);
+}
+
+inline KeysetHandler MakeSyntheticKeyset(KeysetShape shape, size_t num_keys, uint64_t seed) {
+  KeysetHandler keyset;
+  for (auto& key : GenerateKeyset(shape, num_keys, seed))
+    keyset.insert(key);
+  keyset.update_list();
+  return keyset;
+}
+
+}
+
+#endif //PLAIN_DA_TRIES__KEYSET_GENERATOR_HPP_
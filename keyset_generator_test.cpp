@@ -0,0 +1,112 @@
+#include "keyset_generator.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plain_da.hpp"
+#include "keyset.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 5000;
+// Keys of the golden checksums, generated by the seed 1.
+constexpr int NumGoldenKeys = 100;
+
+// FNV-1a of the keys each followed by a newline, as written by gen_keyset.
+uint64_t Checksum(const std::vector<std::string>& keys) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto& key : keys) {
+    for (unsigned char c : key + '\n') {
+      hash ^= c;
+      hash *= 0x100000001b3ull;
+    }
+  }
+  return hash;
+}
+
+// golden is the checksum of the keys generated once, which pins the output across processes,
+// compilers and platforms.
+template <class Pred>
+bool Test(plain_da::KeysetShape shape, uint64_t golden, Pred valid_key) {
+  using namespace plain_da;
+  std::cout << "Test KeysetGenerator " << kKeysetShapeNames[(int) shape] << "..." << std::endl;
+  auto keys = GenerateKeyset(shape, NumKeys, 1);
+  if (keys.size() != NumKeys) {
+    std::cout << "Test failed: generated " << keys.size() << " keys" << std::endl;
+    return false;
+  }
+  if (std::adjacent_find(keys.begin(), keys.end(), std::greater_equal<>()) != keys.end()) {
+    std::cout << "Test failed: keys are not sorted or unique" << std::endl;
+    return false;
+  }
+  if (auto it = std::find_if_not(keys.begin(), keys.end(), valid_key); it != keys.end()) {
+    std::cout << "Test failed: invalid key " << *it << std::endl;
+    return false;
+  }
+  if (GenerateKeyset(shape, NumKeys, 1) != keys) {
+    std::cout << "Test failed: keys are not deterministic" << std::endl;
+    return false;
+  }
+  if (GenerateKeyset(shape, NumKeys, 2) == keys) {
+    std::cout << "Test failed: keys do not depend on the seed" << std::endl;
+    return false;
+  }
+  if (auto checksum = Checksum(GenerateKeyset(shape, NumGoldenKeys, 1)); checksum != golden) {
+    std::cout << "Test failed: checksum " << std::hex << checksum << " != " << golden << std::dec << std::endl;
+    return false;
+  }
+
+  auto keyset = MakeSyntheticKeyset(shape, NumKeys, 1);
+  PlainDaMpTrie<DoubleArrayBase<da_xor_operation_tag, ELM_xcheck_tag>, false> trie(keyset);
+  for (auto& key : keys) {
+    if (!trie.contains(key)) {
+      std::cout << "Test failed: " << key << " is not contained" << std::endl;
+      return false;
+    }
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+bool TestUnknownShape() {
+  std::cout << "Test KeysetGenerator unknown shape..." << std::endl;
+  try {
+    plain_da::ParseKeysetShape("unknown");
+  } catch (const std::invalid_argument&) {
+    std::cout << "OK" << std::endl;
+    return true;
+  }
+  std::cout << "Test failed: unknown shape is parsed" << std::endl;
+  return false;
+}
+
+}
+
+int main() {
+  using plain_da::KeysetShape;
+  auto is_digit = [](char c) { return '0' <= c and c <= '9'; };
+  bool ok = true;
+  ok &= Test(KeysetShape::kUrl, 0x339e81f080bcc2aull, [](const std::string& key) {
+    return key.compare(0, 7, "http://") == 0 or key.compare(0, 8, "https://") == 0;
+  });
+  ok &= Test(KeysetShape::kWord, 0x839f2c8e4378b51aull, [](const std::string& key) {
+    return !key.empty() and std::all_of(key.begin(), key.end(), [](char c) { return 'a' <= c and c <= 'z'; });
+  });
+  ok &= Test(KeysetShape::kDna, 0xf3b643e07349069eull, [](const std::string& key) {
+    return key.size() == plain_da::kDnaKmerLength and key.find_first_not_of("ACGT") == std::string::npos;
+  });
+  ok &= Test(KeysetShape::kNumeric, 0xf335e5b47dc8f12full, [&](const std::string& key) {
+    return !key.empty() and std::all_of(key.begin(), key.end(), is_digit);
+  });
+  ok &= Test(KeysetShape::kPath, 0x9fdc9a9837a24f67ull, [](const std::string& key) {
+    return key[0] == '/' and key.back() != '/' and
+        std::count(key.begin(), key.end(), '/') <= plain_da::kMaxPathDepth + 1;
+  });
+  ok &= TestUnknownShape();
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#ifndef PLAIN_DA_TRIES__MEMORY_USAGE_HPP_
+#define PLAIN_DA_TRIES__MEMORY_USAGE_HPP_
+
+#include <cstddef>
+#include <ostream>
+
+namespace plain_da {
+
+// Bytes of the arrays of a trie by component.
+struct MemoryUsage {
+  size_t da_units = 0;
+  // Bit vector of the enabled units used by the WW construction.
+  size_t exists_bits = 0;
+  // Numbers of disabled units in each page used by the cache-line placement.
+  size_t page_counts = 0;
+  size_t tail = 0;
+  // Rank dictionary identifying the keys.
+  size_t leaves = 0;
+  // Links and counts of the MP-trie for ordered enumeration and ranks.
+  size_t links = 0;
+  // Bytes of the disabled units, which are included in da_units.
+  size_t wasted = 0;
+
+  size_t total() const {
+    return da_units + exists_bits + page_counts + tail + leaves + links;
+  }
+
+  // Ratio of the enabled units.
+  double fill_ratio() const {
+    return da_units == 0 ? 0 : 1 - (double) wasted / da_units;
+  }
+
+  void Print(std::ostream& os, size_t num_keys) const {
+    auto per_key = [&](size_t bytes) { return num_keys == 0 ? 0 : (double) bytes / num_keys; };
+    os << "\tTotal: " << total() << " bytes (" << per_key(total()) << " bytes/key)" << std::endl;
+    os << "\t\tDA units: " << da_units << " bytes (" << per_key(da_units) << " bytes/key)" << std::endl;
+    os << "\t\tWasted units: " << wasted << " bytes (fill ratio " << fill_ratio() << ")" << std::endl;
+    os << "\t\tExists bits: " << exists_bits << " bytes" << std::endl;
+    os << "\t\tPage counts: " << page_counts << " bytes" << std::endl;
+    os << "\t\tTail: " << tail << " bytes" << std::endl;
+    os << "\t\tLeaves: " << leaves << " bytes" << std::endl;
+    os << "\t\tLinks: " << links << " bytes" << std::endl;
+  }
+};
+
+}
+
+#endif //PLAIN_DA_TRIES__MEMORY_USAGE_HPP_
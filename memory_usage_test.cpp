@@ -0,0 +1,70 @@
+#include "memory_usage.hpp"
+
+#include <iostream>
+
+#include "plain_da.hpp"
+#include "compact_da.hpp"
+#include "keyset.hpp"
+#include "test_keyset.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 4000;
+
+template <class Trie>
+bool Test(const std::string& name, const plain_da::KeysetHandler& keyset,
+          size_t unit_bytes, bool has_exists_bits, bool has_page_counts, bool has_tail, bool has_links) {
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie trie(plain_da::RawTrie{keyset});
+  auto usage = trie.memory_usage();
+  if (usage.da_units != trie.size() * unit_bytes or usage.wasted >= usage.da_units) {
+    std::cout << "Test failed: da_units = " << usage.da_units << ", wasted = " << usage.wasted << std::endl;
+    return false;
+  }
+  if (usage.fill_ratio() <= 0 or usage.fill_ratio() > 1) {
+    std::cout << "Test failed: fill_ratio = " << usage.fill_ratio() << std::endl;
+    return false;
+  }
+  if (has_exists_bits != (usage.exists_bits > 0) or
+      has_page_counts != (usage.page_counts > 0) or
+      has_tail != (usage.tail > 0) or
+      has_links != (usage.links > 0)) {
+    std::cout << "Test failed: exists_bits = " << usage.exists_bits << ", page_counts = " << usage.page_counts
+              << ", tail = " << usage.tail
+              << ", links = " << usage.links << std::endl;
+    return false;
+  }
+  auto sum = usage.da_units + usage.exists_bits + usage.page_counts + usage.tail + usage.leaves + usage.links;
+  if (usage.total() != sum or trie.size_in_bytes() != sum) {
+    std::cout << "Test failed: size_in_bytes = " << trie.size_in_bytes() << " is not " << sum << std::endl;
+    return false;
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType, typename PlacementTag = plain_da::first_fit_placement_tag>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>;
+
+}
+
+int main() {
+  auto keyset = plain_da::MakeTestKeyset(plain_da::MakeTestKeys(NumKeys, 0));
+
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<PlainDaTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>(
+      "MemoryUsage PlainDa+ ELM", keyset, 8, false, false, false, false);
+  ok &= Test<PlainDaTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>(
+      "MemoryUsage PlainDax WW", keyset, 8, true, false, false, false);
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, CNV_xcheck_tag>, false>>(
+      "MemoryUsage MP+ CNV", keyset, 8, false, false, true, true);
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, WW_ELM_xcheck_tag>, false>>(
+      "MemoryUsage MPx WW_ELM", keyset, 8, true, false, true, true);
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag, cache_line_placement_tag>, false>>(
+      "MemoryUsage MP+ ELM cache-line placement", keyset, 8, false, true, true, true);
+  ok &= Test<CompactDaMpTrie>("MemoryUsage Compact", keyset, 4, false, false, true, false);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#ifndef PLAIN_DA_TRIES__PERF_COUNTERS_HPP_
+#define PLAIN_DA_TRIES__PERF_COUNTERS_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <optional>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace plain_da {
+
+// Hardware performance counters of the calling thread read by perf_event_open.
+// Events unavailable on the machine (e.g. in a VM or by perf_event_paranoid) are reported as nullopt.
+class PerfCounters {
+ public:
+  enum Event {
+    kInstructions,
+    kCacheMisses,
+    kDtlbMisses,
+    kBranchMisses,
+    kNumEvents,
+  };
+
+  static constexpr const char* kEventNames[kNumEvents] = {
+      "instructions",
+      "cache_misses",
+      "dtlb_misses",
+      "branch_misses",
+  };
+
+ private:
+  std::array<int, kNumEvents> fds_;
+  std::array<uint64_t, kNumEvents> values_{};
+
+ public:
+  PerfCounters() {
+    fds_[kInstructions] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds_[kCacheMisses] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds_[kDtlbMisses] = _open(PERF_TYPE_HW_CACHE,
+                              PERF_COUNT_HW_CACHE_DTLB |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    fds_[kBranchMisses] = _open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  }
+  ~PerfCounters() {
+    for (int fd : fds_) {
+      if (fd >= 0)
+        ::close(fd);
+    }
+  }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  void Start() {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  void Stop() {
+    for (size_t i = 0; i < kNumEvents; i++) {
+      if (fds_[i] < 0)
+        continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      if (::read(fds_[i], &values_[i], sizeof(uint64_t)) != sizeof(uint64_t))
+        values_[i] = 0;
+    }
+  }
+
+  // Count of event between the last Start and Stop.
+  std::optional<uint64_t> value(Event event) const {
+    if (fds_[event] < 0)
+      return std::nullopt;
+    return values_[event];
+  }
+
+ private:
+  static int _open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+};
+
+}
+
+#endif //PLAIN_DA_TRIES__PERF_COUNTERS_HPP_
@@ -6,34 +6,47 @@
 #include <cstring>
 #include <vector>
 #include <deque>
+#include <queue>
+#include <tuple>
 #include <unordered_map>
 #include <limits>
 #include <cassert>
-#include <iostream>
+#include <ostream>
+#include <istream>
 #include <bitset>
-#include <chrono>
 #include <iterator>
 #include <numeric>
 #include <algorithm>
 #include <stdexcept>
+#include <optional>
+#include <memory>
 
 #include "double_array_base.hpp"
 #include "tail.hpp"
 #include "keyset.hpp"
+#include "image.hpp"
+#include "build_stats.hpp"
+#include "sorted_keys_builder.hpp"
 
 namespace plain_da {
 
-template <typename DaType, bool EdgeOrdering>
+template <typename DaType, bool EdgeOrdering, typename StatsType = NoBuildStats>
 class PlainDaTrie {
  public:
   using da_type = DaType;
 
  private:
+  static constexpr uint32_t kImageTrieId = 0;
+
+  std::shared_ptr<MappedFile> image_;
   da_type bc_;
+  SuccinctBitVector leaves_;
+  StatsType build_stats_;
 
  public:
   PlainDaTrie() = default;
 
+  // Keys may contain '\0', as the terminals are marked by flags and no label is stored apart from the units.
   explicit PlainDaTrie(const KeysetHandler& keyset) {
     Build(keyset);
   }
@@ -44,40 +57,250 @@ class PlainDaTrie {
   }
   void Build(const RawTrie& trie);
 
+  // Build from sorted distinct keys given one at a time without materializing the keyset nor RawTrie,
+  // so that the memory for construction stays about the size of the trie. See SortedKeysBuilder.
+  // Children are placed in label order before their parent, so EdgeOrdering is ignored, and the placement
+  // of the DaType gets no parent hint (cache_line_placement_tag falls back to the search of the ConstructionType).
+  template <typename InputIt>
+  void BuildFromSorted(InputIt begin, InputIt end) {
+    _build_from_sorted([&](auto& builder) {
+      for (; begin != end; ++begin)
+        builder.Add(*begin);
+    });
+  }
+  // Build from sorted distinct keys on each line of is.
+  void BuildFromSorted(std::istream& is) {
+    _build_from_sorted([&](auto& builder) {
+      for (std::string key; std::getline(is, key); )
+        builder.Add(key);
+    });
+  }
+
+  // Statistics of the last Build, collected if StatsType is BuildStats.
+  const StatsType& build_stats() const { return build_stats_; }
+
+  // Write the image of the trie to be loaded by Load.
+  void Save(std::ostream& os) const {
+    ImageWriter writer(os);
+    writer.WriteValue(MakeImageHeader<da_type>(kImageTrieId, EdgeOrdering));
+    bc_.Write(writer);
+    leaves_.Write(writer);
+    writer.Finish();
+  }
+
+  // Map the image written by Save. Queries are served from the mapping without copy.
+  void Load(const std::string& path) {
+    PlainDaTrie loaded;
+    loaded.image_ = std::make_shared<MappedFile>(path);
+    ImageReader reader(loaded.image_->data(), loaded.image_->size());
+    CheckImageHeader(reader.ReadValue<ImageHeader>(), MakeImageHeader<da_type>(kImageTrieId, EdgeOrdering));
+    loaded.bc_.Map(reader);
+    loaded.leaves_.Map(reader);
+    reader.CheckEnd();
+    CheckImageSection(loaded.leaves_.size() == loaded.bc_.size(), "leaves");
+    *this = std::move(loaded);
+  }
+
   size_t size() const { return bc_.size(); }
 
+  size_t num_keys() const { return leaves_.num_ones(); }
+
+  // Bytes of the arrays by component.
+  MemoryUsage memory_usage() const {
+    auto usage = bc_.memory_usage();
+    usage.leaves = leaves_.size_in_bytes();
+    return usage;
+  }
+
+  size_t size_in_bytes() const { return memory_usage().total(); }
+
   bool contains(const std::string& key) const {
-    return _contains(key);
+    return _find(key) != kInvalidIndex;
   }
   bool contains(std::string_view key) const {
-    return _contains(key);
+    return _find(key) != kInvalidIndex;
+  }
+
+  // Dense ID in [0, num_keys()) of the key, or nullopt if the key is not contained.
+  std::optional<uint32_t> lookup(const std::string& key) const {
+    return _leaf_id(_find(key));
+  }
+  std::optional<uint32_t> lookup(std::string_view key) const {
+    return _leaf_id(_find(key));
+  }
+
+  // Lookup keys in [begin, end) and write results to out in order.
+  // Up to kBatchSize keys are traversed in lockstep so that their cache misses overlap.
+  template <typename InputIt, typename OutputIt>
+  OutputIt contains_batch(InputIt begin, InputIt end, OutputIt out) const {
+    return _for_each_batch(begin, end, out, [](index_type leaf) { return leaf != kInvalidIndex; });
+  }
+  template <typename InputIt, typename OutputIt>
+  OutputIt lookup_batch(InputIt begin, InputIt end, OutputIt out) const {
+    return _for_each_batch(begin, end, out, [&](index_type leaf) { return _leaf_id(leaf); });
+  }
+
+  // Restore the key of ID by climbing check pointers from its terminal unit.
+  std::string reverse_lookup(uint32_t id) const {
+    if (id >= num_keys())
+      throw std::out_of_range("ID is out of range of keys.");
+    std::string key;
+    _climb(leaves_.select(id), key);
+    std::reverse(key.begin(), key.end());
+    return key;
+  }
+
+  // Report (length, ID) of every key that is a prefix of text in ascending order of length.
+  std::vector<std::pair<size_t, uint32_t>> common_prefix_search(std::string_view text) const {
+    std::vector<std::pair<size_t, uint32_t>> results;
+    index_type idx = 0;
+    for (size_t depth = 0; ; depth++) {
+      if (bc_[idx].IsTerminal())
+        results.emplace_back(depth, leaves_.rank(idx));
+      if (depth == text.size())
+        break;
+      auto nxt = bc_.Operate(bc_[idx].base(), text[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        break;
+      idx = nxt;
+    }
+    return results;
+  }
+
+  // (length, ID) of the longest key that is a prefix of text, or nullopt if no key is.
+  std::optional<std::pair<size_t, uint32_t>> longest_prefix(std::string_view text) const {
+    index_type longest = kInvalidIndex;
+    size_t length = 0;
+    index_type idx = 0;
+    for (size_t depth = 0; ; depth++) {
+      if (bc_[idx].IsTerminal()) {
+        longest = idx;
+        length = depth;
+      }
+      if (depth == text.size())
+        break;
+      auto nxt = bc_.Operate(bc_[idx].base(), text[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        break;
+      idx = nxt;
+    }
+    if (longest == kInvalidIndex)
+      return std::nullopt;
+    return std::make_pair(length, (uint32_t) leaves_.rank(longest));
   }
  private:
+  // Append labels on the path from idx to the root in reverse order.
+  void _climb(index_type idx, std::string& key_rev) const {
+    while (idx != 0) {
+      auto parent = bc_[idx].check();
+      key_rev.push_back(bc_.RestoreLabel(bc_[parent].base(), idx));
+      idx = parent;
+    }
+  }
+
+  // Returns the index of the terminal unit reached by key, or kInvalidIndex.
   template <typename Key>
-  bool _contains(Key key) const {
+  index_type _find(Key key) const {
     index_type idx = 0;
     for (uint8_t c : key) {
-      auto nxt = bc_.Operate(bc_[idx].base, c);
-      if (nxt >= bc_.size() or bc_[nxt].check != idx) {
-        return false;
+      auto nxt = bc_.Operate(bc_[idx].base(), c);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx) {
+        return kInvalidIndex;
       }
       idx = nxt;
     }
-    auto nxt = bc_.Operate(bc_[idx].base, kLeafChar);
-    return !(nxt >= bc_.size() or bc_[nxt].check != idx);
+    return bc_[idx].IsTerminal() ? idx : kInvalidIndex;
+  }
+
+  template <typename InputIt, typename OutputIt, typename Fn>
+  OutputIt _for_each_batch(InputIt begin, InputIt end, OutputIt out, Fn fn) const {
+    std::string_view keys[kBatchSize];
+    index_type leaves[kBatchSize];
+    while (begin != end) {
+      size_t n = 0;
+      for (; n < kBatchSize and begin != end; ++n, ++begin)
+        keys[n] = *begin;
+      _find_batch(keys, n, leaves);
+      for (size_t i = 0; i < n; i++)
+        *out++ = fn(leaves[i]);
+    }
+    return out;
+  }
+
+  void _find_batch(const std::string_view* keys, size_t n, index_type* leaves) const {
+    index_type idx[kBatchSize], nxt[kBatchSize];
+    size_t depth[kBatchSize];
+    size_t active[kBatchSize];
+    for (size_t i = 0; i < n; i++) {
+      idx[i] = 0;
+      depth[i] = 0;
+      active[i] = i;
+    }
+    size_t m = n;
+    while (m > 0) {
+      // Issue every transition of this step before touching any unit.
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        if (depth[i] == keys[i].size())
+          continue;
+        nxt[i] = bc_.Operate(bc_[idx[i]].base(), keys[i][depth[i]]);
+        bc_.Prefetch(nxt[i]);
+      }
+      size_t k = 0;
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        if (depth[i] == keys[i].size()) {
+          leaves[i] = bc_[idx[i]].IsTerminal() ? idx[i] : kInvalidIndex;
+        } else if (nxt[i] >= bc_.size() or bc_[nxt[i]].check() != idx[i]) {
+          leaves[i] = kInvalidIndex;
+        } else {
+          idx[i] = nxt[i];
+          depth[i]++;
+          active[k++] = i;
+        }
+      }
+      m = k;
+    }
+  }
+
+  bool _is_leaf(index_type i) const {
+    return bc_[i].Enabled() and bc_[i].IsTerminal();
+  }
+
+  std::optional<uint32_t> _leaf_id(index_type leaf) const {
+    if (leaf == kInvalidIndex)
+      return std::nullopt;
+    return leaves_.rank(leaf);
+  }
+
+  void _build_leaves() {
+    BitVector bits(bc_.size());
+    for (size_t i = 0; i < bc_.size(); i++)
+      bits[i] = _is_leaf(i);
+    leaves_ = SuccinctBitVector(std::move(bits));
+  }
+
+  template <typename Feed>
+  void _build_from_sorted(Feed feed) {
+    PlainDaTrie built;
+    SortedKeysBuilder<da_type, StatsType> builder(built.bc_, nullptr, built.build_stats_);
+    feed(builder);
+    builder.Finish();
+    built._build_leaves();
+    built.build_stats_.Finish(built.bc_, 0);
+    *this = std::move(built);
   }
 
 };
 
-template <typename DaType, bool EdgeOrdering>
-void PlainDaTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void PlainDaTrie<DaType, EdgeOrdering, StatsType>::Build(const KeysetHandler& keyset) {
   // A keys in keyset is required to be sorted and unique.
   using key_iterator = typename KeysetHandler::const_iterator;
 
   if constexpr (!EdgeOrdering) {
 
-    size_t cnt_skip = 0;
-    uint64_t time_fb = 0;
+    build_stats_.Clear();
     auto dfs = [&](
         const auto dfs,
         const key_iterator begin,
@@ -85,16 +308,16 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
         int depth,
         index_type da_index
     ) -> void {
-      std::deque<uint8_t> children;
+      std::vector<uint8_t> children;
       assert(begin < end);
       auto keyit = begin;
       if (keyit->size() == depth) {
-        children.push_back(kLeafChar);
+        bc_[da_index].set_terminal(true);
         ++keyit;
       }
 
       std::vector<key_iterator> its;
-      uint8_t pibot_char = kLeafChar;
+      int pibot_char = -1;
       while (keyit < end) {
         uint8_t c = (*keyit)[depth];
         if (pibot_char < c) {
@@ -106,38 +329,33 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
       }
       its.push_back(end);
 
-      assert(!children.empty());
-      auto start_t = std::chrono::high_resolution_clock::now();
-      auto base = bc_.FindBase(children, &cnt_skip);
-      auto end_t = std::chrono::high_resolution_clock::now();
-      time_fb += std::chrono::duration_cast<std::chrono::microseconds>(end_t-start_t).count();
+      if (children.empty())
+        return;
+      auto base = build_stats_.FindBase(bc_, children, da_index);
 
-      bc_[da_index].base = base;
-      CheckExpand(Operate(base, children.back()));
+      bc_[da_index].set_base(base);
+      bc_.CheckExpand(bc_.Operate(base, children.back()));
       for (uint8_t c : children) {
-        auto pos = Operate(base, c);
+        auto pos = bc_.Operate(base, c);
         assert(!bc_[pos].Enabled());
         if (bc_[pos].Enabled()) {
           throw std::logic_error("FindBase is not implemented correctly!");
         }
-        SetEnabled(pos);
-        bc_[pos].check = da_index;
+        bc_.SetEnabled(pos);
+        bc_[pos].set_check(da_index);
       }
 
-      if (children.front() == kLeafChar)
-        children.pop_front();
       for (int i = 0; i < children.size(); i++) {
-        dfs(dfs, its[i], its[i+1], depth+1, Operate(bc_[da_index].base, children[i]));
+        dfs(dfs, its[i], its[i+1], depth+1, bc_.Operate(bc_[da_index].base(), children[i]));
       }
     };
     const index_type root_index = 0;
     bc_.CheckExpand(root_index);
     bc_.SetEnabled(root_index);
-    bc_[root_index].check = std::numeric_limits<index_type>::max();
+    bc_[root_index].set_check(std::numeric_limits<index_type>::max());
     dfs(dfs, keyset.cbegin(), keyset.cend(), 0, root_index);
-
-    std::cout << "\tCount roops: " << cnt_skip << std::endl;
-    std::cout << "\tFindBase time: " << std::fixed << (double)time_fb/1000000 << " ￿s" << std::endl;
+    _build_leaves();
+    build_stats_.Finish(bc_, 0);
 
   } else {
 
@@ -146,20 +364,17 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
   }
 }
 
-template <typename DaType, bool EdgeOrdering>
-void PlainDaTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void PlainDaTrie<DaType, EdgeOrdering, StatsType>::Build(const RawTrie& trie) {
   // A keys in keyset is required to be sorted and unique.
 
-  size_t cnt_skip = 0;
-  uint64_t time_fb = 0;
+  build_stats_.Clear();
   auto da_save_edges = [&](std::vector<uint8_t>& children, index_type da_index) {
-    assert(!children.empty());
-    auto start_t = std::chrono::high_resolution_clock::now();
-    auto base = bc_.FindBase(children, &cnt_skip);
-    auto end_t = std::chrono::high_resolution_clock::now();
-    time_fb += std::chrono::duration_cast<std::chrono::microseconds>(end_t-start_t).count();
+    if (children.empty())
+      return;
+    auto base = build_stats_.FindBase(bc_, children, da_index);
 
-    bc_[da_index].base = base;
+    bc_[da_index].set_base(base);
     bc_.CheckExpand(bc_.Operate(base, children.back()));
     for (uint8_t c : children) {
       auto pos = bc_.Operate(base, c);
@@ -168,7 +383,7 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
         throw std::logic_error("FindBase is not implemented correctly!");
       }
       bc_.SetEnabled(pos);
-      bc_[pos].check = da_index;
+      bc_[pos].set_check(da_index);
     }
   };
 
@@ -183,7 +398,10 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
       std::vector<uint8_t> children;
       children.reserve(edges.size());
       for (auto e : edges) {
-        children.push_back(e.c);
+        if (e.next == -1)
+          bc_[da_index].set_terminal(true);
+        else
+          children.push_back(e.c);
       }
 
       da_save_edges(children, da_index);
@@ -191,13 +409,13 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
       for (auto e : edges) {
         if (e.next == -1)
           continue;
-        dfs(dfs, e.next, bc_.Operate(bc_[da_index].base, e.c));
+        dfs(dfs, e.next, bc_.Operate(bc_[da_index].base(), e.c));
       }
     };
     const index_type root_index = 0;
     bc_.CheckExpand(root_index);
     bc_.SetEnabled(root_index);
-    bc_[root_index].check = std::numeric_limits<index_type>::max();
+    bc_[root_index].set_check(std::numeric_limits<index_type>::max());
     dfs(dfs, 0, root_index);
 
   } else {
@@ -224,42 +442,64 @@ void PlainDaTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
       auto& edges = trie[trie_node];
       std::vector<uint8_t> children;
       children.reserve(edges.size());
-      for (auto e : edges)
-        children.push_back(e.c);
+      std::vector<int> order;
+      for (int i = 0; i < edges.size(); i++) {
+        if (edges[i].next == -1) {
+          bc_[da_index].set_terminal(true);
+        } else {
+          children.push_back(edges[i].c);
+          order.push_back(i);
+        }
+      }
 
       da_save_edges(children, da_index);
 
-      std::deque<int> order(edges.size());
-      std::iota(order.begin(), order.end(), 0);
-      if (children[0] == kLeafChar)
-        order.pop_front();
       std::sort(order.begin(), order.end(), [&](int l, int r) { return size[edges[l].next] > size[edges[r].next]; });
       for (auto i : order) {
         assert(edges[i].next != -1);
-        dfs(dfs, trie[trie_node][i].next, bc_.Operate(bc_[da_index].base, children[i]));
+        dfs(dfs, trie[trie_node][i].next, bc_.Operate(bc_[da_index].base(), edges[i].c));
       }
     };
     const index_type root_index = 0;
     bc_.CheckExpand(root_index);
     bc_.SetEnabled(root_index);
-    bc_[root_index].check = std::numeric_limits<index_type>::max();
+    bc_[root_index].set_check(std::numeric_limits<index_type>::max());
     dfs(dfs, 0, root_index);
 
   }
-
-  std::cout << "\tCount roops: " << cnt_skip << std::endl;
-  std::cout << "\tFindBase time: " << std::fixed << (double)time_fb/1000000 << " ￿s" << std::endl;
+  _build_leaves();
+  build_stats_.Finish(bc_, 0);
 }
 
 
-template <typename DaType, bool EdgeOrdering>
+class CompactDaMpTrie;
+
+template <typename DaType, bool EdgeOrdering, typename StatsType = NoBuildStats>
 class PlainDaMpTrie {
  public:
   using da_type = DaType;
 
+  friend class CompactDaMpTrie;
+
  private:
+  static constexpr uint32_t kImageTrieId = 1;
+
+  std::shared_ptr<MappedFile> image_;
   da_type bc_;
   Tail tail_;
+  SuccinctBitVector leaves_;
+  // Labels of the first child and the next sibling of each unit to enumerate children in order.
+  struct NodeLink {
+    uint8_t child = kLeafChar;
+    uint8_t sibling = kLeafChar;
+  };
+  MappableVector<NodeLink> links_;
+  // Number of keys in the subtrie of the parent lexicographically less than the keys in the subtrie of each unit.
+  // Counts are relative to the parent so that an update changes only the ones of the units on its path and their siblings.
+  MappableVector<uint32_t> less_counts_;
+  // Bytes of the TAIL no longer referenced after Insert/Erase, which Save and Relayout reclaim.
+  size_t tail_garbage_ = 0;
+  StatsType build_stats_;
 
  public:
   PlainDaMpTrie() = default;
@@ -272,19 +512,439 @@ class PlainDaMpTrie {
   explicit PlainDaMpTrie(const RawTrie& trie) {
     Build(trie);
   }
-  void Build(const RawTrie& trie);
+  void Build(const RawTrie& trie) {
+    Build(trie, {});
+  }
+
+  // Build from keys weighted by their access frequencies, given in the order of keys.
+  // Nodes are placed in descending order of the total weights of their subtries,
+  // so that the units on the paths of hot keys are packed together at the front of the array.
+  PlainDaMpTrie(const KeysetHandler& keyset, const std::vector<uint64_t>& weights) {
+    Build(keyset, weights);
+  }
+  void Build(const KeysetHandler& keyset, const std::vector<uint64_t>& weights) {
+    Build(RawTrie(keyset), weights);
+  }
+  PlainDaMpTrie(const RawTrie& trie, const std::vector<uint64_t>& weights) {
+    Build(trie, weights);
+  }
+  void Build(const RawTrie& trie, const std::vector<uint64_t>& weights);
+
+  // Build from sorted distinct keys given one at a time without materializing the keyset nor RawTrie,
+  // so that the memory for construction stays about the size of the trie. See SortedKeysBuilder.
+  // Children are placed in label order before their parent, so EdgeOrdering is ignored, and the placement
+  // of the DaType gets no parent hint (cache_line_placement_tag falls back to the search of the ConstructionType).
+  // Rests of keys are appended to the TAIL without sharing their suffixes unlike Build.
+  template <typename InputIt>
+  void BuildFromSorted(InputIt begin, InputIt end) {
+    _build_from_sorted([&](auto& builder) {
+      for (; begin != end; ++begin)
+        builder.Add(*begin);
+    });
+  }
+  // Build from sorted distinct keys on each line of is.
+  void BuildFromSorted(std::istream& is) {
+    _build_from_sorted([&](auto& builder) {
+      for (std::string key; std::getline(is, key); )
+        builder.Add(key);
+    });
+  }
+
+  // Statistics of the last Build, collected if StatsType is BuildStats.
+  const StatsType& build_stats() const { return build_stats_; }
+
+  // Insert key into the trie. Returns false if key is already contained.
+  // Throws std::invalid_argument if key contains '\0', as Build does.
+  // IDs of other keys may change since an ID is the rank of the leaf unit on the array.
+  bool Insert(std::string_view key);
+
+  // Erase key from the trie. Returns false if key is not contained.
+  // The label of key on the TAIL is counted as garbage until Save or Relayout.
+  bool Erase(std::string_view key);
+
+  // Bytes of the TAIL left unreferenced by Insert/Erase. Labels sharing their suffixes are counted separately.
+  size_t tail_garbage() const { return tail_garbage_; }
+
+  // Number of top levels placed in breadth-first order by Relayout.
+  static constexpr size_t kRelayoutBfsDepth = 3;
+
+  // Rebuild the array so that the nodes of the top bfs_depth levels, which every lookup passes,
+  // are packed at the front in breadth-first order, and each subtrie below them follows
+  // in depth-first order. Labels on the TAIL are rebuilt too, reclaiming the ones of erased keys.
+  // IDs of keys may change since an ID is the rank of the leaf unit on the array.
+  void Relayout(size_t bfs_depth = kRelayoutBfsDepth);
+
+  // Write the image of the trie to be loaded by Load.
+  // The TAIL is compacted on the image if Insert/Erase left garbage on it.
+  void Save(std::ostream& os) const {
+    if (tail_garbage_ == 0) {
+      _save(os, bc_, tail_);
+      return;
+    }
+    auto bc = bc_;
+    auto tail = _rebuild_tail(bc);
+    _save(os, bc, tail);
+  }
+
+  // Map the image written by Save. Queries are served from the mapping without copy,
+  // and the pages are shared between processes loading the same image.
+  void Load(const std::string& path) {
+    PlainDaMpTrie loaded;
+    loaded.image_ = std::make_shared<MappedFile>(path);
+    ImageReader reader(loaded.image_->data(), loaded.image_->size());
+    CheckImageHeader(reader.ReadValue<ImageHeader>(), MakeImageHeader<da_type>(kImageTrieId, EdgeOrdering));
+    loaded.bc_.Map(reader);
+    loaded.tail_.Map(reader);
+    loaded.leaves_.Map(reader);
+    reader.MapVector(loaded.links_);
+    reader.MapVector(loaded.less_counts_);
+    reader.CheckEnd();
+    auto size = loaded.bc_.size();
+    CheckImageSection(loaded.leaves_.size() == size, "leaves");
+    CheckImageSection(loaded.links_.size() == size and loaded.less_counts_.size() == size, "links");
+    *this = std::move(loaded);
+  }
 
   size_t size() const { return bc_.size(); }
 
+  size_t num_keys() const { return leaves_.num_ones(); }
+
+  // Bytes of the arrays by component.
+  MemoryUsage memory_usage() const {
+    auto usage = bc_.memory_usage();
+    usage.tail = tail_.size_in_bytes();
+    usage.leaves = leaves_.size_in_bytes();
+    usage.links = links_.size_in_bytes() + less_counts_.size_in_bytes();
+    return usage;
+  }
+
+  size_t size_in_bytes() const { return memory_usage().total(); }
+
+  bool empty() const { return num_keys() == 0; }
+
   bool contains(const std::string& key) const {
-    return _contains(key);
+    return _find(key) != kInvalidIndex;
   }
   bool contains(std::string_view key) const {
-    return _contains(key);
+    return _find(key) != kInvalidIndex;
+  }
+
+  // Dense ID in [0, num_keys()) of the key, or nullopt if the key is not contained.
+  std::optional<uint32_t> lookup(const std::string& key) const {
+    return _leaf_id(_find(key));
+  }
+  std::optional<uint32_t> lookup(std::string_view key) const {
+    return _leaf_id(_find(key));
+  }
+
+  // Lookup keys in [begin, end) and write results to out in order.
+  // Up to kBatchSize keys are traversed in lockstep so that their cache misses overlap.
+  template <typename InputIt, typename OutputIt>
+  OutputIt contains_batch(InputIt begin, InputIt end, OutputIt out) const {
+    return _for_each_batch(begin, end, out, [](index_type leaf) { return leaf != kInvalidIndex; });
+  }
+  template <typename InputIt, typename OutputIt>
+  OutputIt lookup_batch(InputIt begin, InputIt end, OutputIt out) const {
+    return _for_each_batch(begin, end, out, [&](index_type leaf) { return _leaf_id(leaf); });
+  }
+
+  // Restore the key of ID by climbing check pointers from its leaf unit and appending its TAIL.
+  std::string reverse_lookup(uint32_t id) const {
+    if (id >= num_keys())
+      throw std::out_of_range("ID is out of range of keys.");
+    index_type leaf = leaves_.select(id);
+    std::string key;
+    _climb(leaf, key);
+    std::reverse(key.begin(), key.end());
+    if (!bc_[leaf].HasBase())
+      key += tail_.label(bc_[leaf].tail_i());
+    return key;
+  }
+
+  // Report (length, ID) of every key that is a prefix of text in ascending order of length.
+  std::vector<std::pair<size_t, uint32_t>> common_prefix_search(std::string_view text) const {
+    std::vector<std::pair<size_t, uint32_t>> results;
+    index_type idx = 0;
+    for (size_t depth = 0; ; depth++) {
+      if (!bc_[idx].HasBase()) { // The last candidate is on a TAIL
+        auto len = _tail_prefix_length(bc_[idx].tail_i(), text.substr(depth));
+        if (len != std::string_view::npos)
+          results.emplace_back(depth + len, leaves_.rank(idx));
+        break;
+      }
+      if (bc_[idx].IsTerminal())
+        results.emplace_back(depth, leaves_.rank(idx));
+      if (depth == text.size())
+        break;
+      auto nxt = bc_.Operate(bc_[idx].base(), text[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        break;
+      idx = nxt;
+    }
+    return results;
+  }
+
+  // (length, ID) of the longest key that is a prefix of text, or nullopt if no key is.
+  std::optional<std::pair<size_t, uint32_t>> longest_prefix(std::string_view text) const {
+    index_type longest = kInvalidIndex;
+    size_t length = 0;
+    index_type idx = 0;
+    for (size_t depth = 0; ; depth++) {
+      if (!bc_[idx].HasBase()) { // The deepest candidate is on a TAIL
+        auto len = _tail_prefix_length(bc_[idx].tail_i(), text.substr(depth));
+        if (len != std::string_view::npos) {
+          longest = idx;
+          length = depth + len;
+        }
+        break;
+      }
+      if (bc_[idx].IsTerminal()) {
+        longest = idx;
+        length = depth;
+      }
+      if (depth == text.size())
+        break;
+      auto nxt = bc_.Operate(bc_[idx].base(), text[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        break;
+      idx = nxt;
+    }
+    if (longest == kInvalidIndex)
+      return std::nullopt;
+    return std::make_pair(length, (uint32_t) leaves_.rank(longest));
+  }
+
+  // Cursor visiting keys of a subtrie lazily in lexicographical order.
+  // Iteration continues while the cursor is evaluated as true.
+  // The key buffer and the path are reused, so advancing does not allocate a string per step.
+  class Cursor {
+   private:
+    const PlainDaMpTrie* trie_ = nullptr;
+    std::vector<index_type> path_; // Units from the root of subtrie to the current leaf.
+    std::string key_;
+    size_t tail_length_ = 0;
+
+    friend class PlainDaMpTrie;
+    explicit Cursor(const PlainDaMpTrie* trie) : trie_(trie) {
+      path_.push_back(0);
+    }
+    Cursor(const PlainDaMpTrie* trie, index_type root, std::string_view key_prefix)
+        : trie_(trie), key_(key_prefix) {
+      path_.push_back(root);
+      _descend();
+    }
+
+   public:
+    Cursor() = default;
+
+    explicit operator bool() const { return !path_.empty(); }
+
+    std::string_view key() const { return key_; }
+
+    uint32_t id() const { return trie_->leaves_.rank(path_.back()); }
+
+    Cursor& operator++() {
+      _advance();
+      return *this;
+    }
+
+   private:
+    // Follow first children down to the leftmost leaf.
+    void _descend() {
+      auto& bc = trie_->bc_;
+      while (true) {
+        auto idx = path_.back();
+        if (!bc[idx].HasBase()) {
+          auto label = trie_->tail_.label(bc[idx].tail_i());
+          key_ += label;
+          tail_length_ = label.size();
+          return;
+        }
+        if (bc[idx].IsTerminal())
+          return;
+        uint8_t c = trie_->links_[idx].child;
+        path_.push_back(bc.Operate(bc[idx].base(), c));
+        key_.push_back(c);
+      }
+    }
+
+    // Move to the first key not less than key, walking down from the root.
+    void _lower_bound(std::string_view key) {
+      auto& bc = trie_->bc_;
+      auto& links = trie_->links_;
+      for (size_t depth = 0; ; depth++) {
+        auto idx = path_.back();
+        if (!bc[idx].HasBase()) {
+          auto label = trie_->tail_.label(bc[idx].tail_i());
+          key_ += label;
+          tail_length_ = label.size();
+          if (label < key.substr(depth))
+            _skip_subtrie();
+          return;
+        }
+        if (depth == key.size()) {
+          _descend();
+          return;
+        }
+        if (!trie_->_has_child(idx)) { // Only the key terminating here, which is a prefix of key.
+          _skip_subtrie();
+          return;
+        }
+        // Find the smallest child label not less than key[depth].
+        uint8_t c = key[depth];
+        auto base = bc[idx].base();
+        uint8_t label = links[idx].child;
+        while (label < c and links[bc.Operate(base, label)].sibling != kLeafChar)
+          label = links[bc.Operate(base, label)].sibling;
+        if (label < c) { // All keys in this subtrie are less than key.
+          _skip_subtrie();
+          return;
+        }
+        path_.push_back(bc.Operate(base, label));
+        key_.push_back(label);
+        if (label > c) {
+          _descend();
+          return;
+        }
+      }
+    }
+
+    // Descend into the children of a terminal unit, or skip the current subtrie otherwise.
+    void _advance() {
+      auto& bc = trie_->bc_;
+      auto idx = path_.back();
+      if (!trie_->_has_child(idx)) {
+        _skip_subtrie();
+        return;
+      }
+      uint8_t c = trie_->links_[idx].child;
+      path_.push_back(bc.Operate(bc[idx].base(), c));
+      key_.push_back(c);
+      _descend();
+    }
+
+    // Climb up to the nearest unit having a next sibling and descend from the sibling.
+    void _skip_subtrie() {
+      key_.resize(key_.size() - tail_length_);
+      tail_length_ = 0;
+      auto& bc = trie_->bc_;
+      while (path_.size() > 1) {
+        auto idx = path_.back();
+        path_.pop_back();
+        auto parent = path_.back();
+        key_.pop_back();
+        uint8_t sibling = trie_->links_[idx].sibling;
+        if (sibling != kLeafChar) {
+          path_.push_back(bc.Operate(bc[parent].base(), sibling));
+          key_.push_back(sibling);
+          _descend();
+          return;
+        }
+      }
+      path_.clear();
+    }
+  };
+
+  // Cursor at the smallest key.
+  Cursor begin() const {
+    if (empty())
+      return Cursor();
+    return Cursor(this, 0, "");
+  }
+
+  // Cursor at the smallest key not less than key.
+  Cursor lower_bound(std::string_view key) const {
+    if (empty())
+      return Cursor();
+    Cursor cursor(this);
+    cursor._lower_bound(key);
+    return cursor;
+  }
+
+  // Cursor at the smallest key greater than key.
+  Cursor upper_bound(std::string_view key) const {
+    auto cursor = lower_bound(key);
+    if (cursor and cursor.key() == key)
+      ++cursor;
+    return cursor;
+  }
+
+  // Number of keys starting with prefix.
+  size_t count_prefix(std::string_view prefix) const {
+    if (empty())
+      return 0;
+    index_type idx = 0;
+    size_t less = 0, end = num_keys();
+    for (size_t depth = 0; depth < prefix.size(); depth++) {
+      if (!bc_[idx].HasBase()) {
+        auto rest = prefix.substr(depth);
+        return tail_.label(bc_[idx].tail_i()).substr(0, rest.size()) == rest ? 1 : 0;
+      }
+      auto nxt = bc_.Operate(bc_[idx].base(), prefix[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        return 0;
+      end = _subtrie_end(idx, nxt, less, end);
+      less += less_counts_[nxt];
+      idx = nxt;
+    }
+    return end - less;
+  }
+
+  // Number of keys less than key in lexicographical order.
+  size_t rank(std::string_view key) const {
+    if (empty())
+      return 0;
+    index_type idx = 0;
+    size_t less = 0, end = num_keys();
+    for (size_t depth = 0; ; depth++) {
+      if (!bc_[idx].HasBase())
+        return less + (tail_.label(bc_[idx].tail_i()) < key.substr(depth) ? 1 : 0);
+      if (depth == key.size())
+        return less;
+      auto nxt = bc_.Operate(bc_[idx].base(), key[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx) {
+        // Keys are less than key up to the smallest child greater than key[depth].
+        auto greater = _next_child(idx, key[depth]);
+        return greater == kInvalidIndex ? end : less + less_counts_[greater];
+      }
+      end = _subtrie_end(idx, nxt, less, end);
+      less += less_counts_[nxt];
+      idx = nxt;
+    }
+  }
+
+  // Cursor over the keys starting with prefix.
+  Cursor predictive_search(std::string_view prefix) const {
+    if (empty())
+      return Cursor();
+    index_type idx = 0;
+    for (size_t depth = 0; depth < prefix.size(); depth++) {
+      if (!bc_[idx].HasBase()) { // The rest of prefix is required to be on the TAIL
+        auto rest = prefix.substr(depth);
+        if (tail_.label(bc_[idx].tail_i()).substr(0, rest.size()) != rest)
+          return Cursor();
+        return Cursor(this, idx, prefix.substr(0, depth));
+      }
+      auto nxt = bc_.Operate(bc_[idx].base(), prefix[depth]);
+      if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+        return Cursor();
+      idx = nxt;
+    }
+    return Cursor(this, idx, prefix);
   }
  private:
+  // Append labels on the path from idx to the root in reverse order.
+  void _climb(index_type idx, std::string& key_rev) const {
+    while (idx != 0) {
+      auto parent = bc_[idx].check();
+      key_rev.push_back(bc_.RestoreLabel(bc_[parent].base(), idx));
+      idx = parent;
+    }
+  }
+
+  // Returns the index of the terminal unit (or the TAIL unit) reached by key, or kInvalidIndex.
   template <typename Key>
-  bool _contains(Key key) const {
+  index_type _find(Key key) const {
     index_type idx = 0;
     auto it = key.begin();
     for (; it != key.end(); ++it) {
@@ -292,38 +952,443 @@ class PlainDaMpTrie {
         break;
       auto nxt = bc_.Operate(bc_[idx].base(), *it);
       if (nxt >= bc_.size() or bc_[nxt].check() != idx) {
-        return false;
+        return kInvalidIndex;
       }
       idx = nxt;
     }
-    if (bc_[idx].HasBase()) { // Check leaf transition
-      if (it != key.end())
-        return false;
-      auto nxt = bc_.Operate(bc_[idx].base(), kLeafChar);
-      return nxt < bc_.size() and bc_[nxt].check() == idx;
+    if (bc_[idx].HasBase()) { // Check terminal flag
+      return it == key.end() and bc_[idx].IsTerminal() ? idx : kInvalidIndex;
     } else { // Compare on a TAIL
       size_t tail_i = bc_[idx].tail_i();
       for (; it != key.end(); ++it, ++tail_i) {
         if (tail_i < tail_.size() and *it != tail_[tail_i])
-          return false;
+          return kInvalidIndex;
+      }
+      return tail_i < tail_.size() and tail_[tail_i] == (char) kLeafChar ? idx : kInvalidIndex;
+    }
+  }
+
+  // Length of the label on the TAIL from tail_i if it is a prefix of text, or npos.
+  size_t _tail_prefix_length(size_t tail_i, std::string_view text) const {
+    for (size_t i = 0; ; i++, tail_i++) {
+      if (tail_[tail_i] == (char) kLeafChar)
+        return i;
+      if (i == text.size() or tail_[tail_i] != text[i])
+        return std::string_view::npos;
+    }
+  }
+
+  bool _tail_equals(size_t tail_i, std::string_view suffix) const {
+    for (char c : suffix) {
+      if (tail_i >= tail_.size() or c != tail_[tail_i])
+        return false;
+      ++tail_i;
+    }
+    return tail_i < tail_.size() and tail_[tail_i] == (char) kLeafChar;
+  }
+
+  template <typename InputIt, typename OutputIt, typename Fn>
+  OutputIt _for_each_batch(InputIt begin, InputIt end, OutputIt out, Fn fn) const {
+    std::string_view keys[kBatchSize];
+    index_type leaves[kBatchSize];
+    while (begin != end) {
+      size_t n = 0;
+      for (; n < kBatchSize and begin != end; ++n, ++begin)
+        keys[n] = *begin;
+      _find_batch(keys, n, leaves);
+      for (size_t i = 0; i < n; i++)
+        *out++ = fn(leaves[i]);
+    }
+    return out;
+  }
+
+  void _find_batch(const std::string_view* keys, size_t n, index_type* leaves) const {
+    index_type idx[kBatchSize], nxt[kBatchSize];
+    size_t depth[kBatchSize];
+    size_t active[kBatchSize];
+    for (size_t i = 0; i < n; i++) {
+      idx[i] = 0;
+      depth[i] = 0;
+      active[i] = i;
+    }
+    size_t m = n;
+    while (m > 0) {
+      // Issue every transition (or TAIL access) of this step before touching any of them.
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        auto& unit = bc_[idx[i]];
+        if (!unit.HasBase()) {
+          tail_.Prefetch(unit.tail_i());
+          continue;
+        }
+        if (depth[i] == keys[i].size())
+          continue;
+        nxt[i] = bc_.Operate(unit.base(), keys[i][depth[i]]);
+        bc_.Prefetch(nxt[i]);
+      }
+      size_t k = 0;
+      for (size_t j = 0; j < m; j++) {
+        auto i = active[j];
+        if (!bc_[idx[i]].HasBase()) {
+          bool ok = _tail_equals(bc_[idx[i]].tail_i(), keys[i].substr(depth[i]));
+          leaves[i] = ok ? idx[i] : kInvalidIndex;
+        } else if (depth[i] == keys[i].size()) {
+          leaves[i] = bc_[idx[i]].IsTerminal() ? idx[i] : kInvalidIndex;
+        } else if (nxt[i] >= bc_.size() or bc_[nxt[i]].check() != idx[i]) {
+          leaves[i] = kInvalidIndex;
+        } else {
+          idx[i] = nxt[i];
+          depth[i]++;
+          active[k++] = i;
+        }
+      }
+      m = k;
+    }
+  }
+
+  // Leaf units are the ones storing a TAIL or having the terminal flag.
+  bool _is_leaf(index_type i) const {
+    return bc_[i].Enabled() and (!bc_[i].HasBase() or bc_[i].IsTerminal());
+  }
+
+  std::optional<uint32_t> _leaf_id(index_type leaf) const {
+    if (leaf == kInvalidIndex)
+      return std::nullopt;
+    return leaves_.rank(leaf);
+  }
+
+  void _build_leaves() {
+    BitVector bits(bc_.size());
+    for (size_t i = 0; i < bc_.size(); i++)
+      bits[i] = _is_leaf(i);
+    leaves_ = SuccinctBitVector(std::move(bits));
+  }
+
+  // Chain children of each node in ascending order of labels.
+  void _build_links() {
+    links_.assign(bc_.size(), {});
+    std::vector<uint8_t> labels(bc_.size());
+    std::vector<size_t> offsets(kAlphabetSize+1);
+    for (size_t i = 1; i < bc_.size(); i++) {
+      if (!bc_[i].Enabled())
+        continue;
+      labels[i] = bc_.RestoreLabel(bc_[bc_[i].check()].base(), i);
+      offsets[labels[i]+1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<index_type> by_label(offsets.back());
+    for (size_t i = 1; i < bc_.size(); i++) {
+      if (bc_[i].Enabled())
+        by_label[offsets[labels[i]]++] = i;
+    }
+    // Prepend children in descending order of labels.
+    BitVector has_child(bc_.size());
+    for (auto it = by_label.rbegin(); it != by_label.rend(); ++it) {
+      auto parent = bc_[*it].check();
+      if (has_child[parent])
+        links_[*it].sibling = links_[parent].child;
+      links_[parent].child = labels[*it];
+      has_child[parent] = true;
+    }
+  }
+
+  // Number of keys before the end of the subtrie of child,
+  // given the ones before the subtrie of its parent and before its end as parent_less and parent_end.
+  size_t _subtrie_end(index_type parent, index_type child, size_t parent_less, size_t parent_end) const {
+    uint8_t sibling = links_[child].sibling;
+    if (sibling == kLeafChar)
+      return parent_end;
+    return parent_less + less_counts_[bc_.Operate(bc_[parent].base(), sibling)];
+  }
+
+  // The child of parent having the smallest label greater than c, or kInvalidIndex.
+  index_type _next_child(index_type parent, uint8_t c) const {
+    if (!_has_child(parent))
+      return kInvalidIndex;
+    auto base = bc_[parent].base();
+    for (uint8_t label = links_[parent].child; ; ) {
+      auto child = bc_.Operate(base, label);
+      if (label > c)
+        return child;
+      label = links_[child].sibling;
+      if (label == kLeafChar)
+        return kInvalidIndex;
+    }
+  }
+
+  // Add delta to the counts of the siblings following child, whose parent is given.
+  void _shift_following_siblings(index_type parent, index_type child, int delta) {
+    auto base = bc_[parent].base();
+    for (uint8_t label = links_[child].sibling; label != kLeafChar; ) {
+      auto sibling = bc_.Operate(base, label);
+      less_counts_[sibling] += delta;
+      label = links_[sibling].sibling;
+    }
+  }
+
+  // Add delta to the counts of all children of idx.
+  void _shift_children(index_type idx, int delta) {
+    if (!_has_child(idx))
+      return;
+    auto first = bc_.Operate(bc_[idx].base(), links_[idx].child);
+    less_counts_[first] += delta;
+    _shift_following_siblings(idx, first, delta);
+  }
+
+  // Count keys preceding each subtrie in preorder, and store the counts relative to the parents.
+  void _build_less_counts() {
+    less_counts_.assign(bc_.size(), 0);
+    if (bc_.size() == 0)
+      return;
+    uint32_t count = 0;
+    // Pairs of a unit and the count before the subtrie of its parent.
+    std::vector<std::pair<index_type, uint32_t>> stack = {{0, 0}};
+    uint8_t labels[kAlphabetSize];
+    while (!stack.empty()) {
+      auto [idx, parent_count] = stack.back();
+      stack.pop_back();
+      less_counts_[idx] = count - parent_count;
+      auto idx_count = count;
+      if (leaves_[idx])
+        count++;
+      if (!_has_child(idx))
+        continue;
+      auto base = bc_[idx].base();
+      size_t n = 0;
+      for (uint8_t label = links_[idx].child; ; label = links_[bc_.Operate(base, label)].sibling) {
+        labels[n++] = label;
+        if (links_[bc_.Operate(base, label)].sibling == kLeafChar)
+          break;
+      }
+      while (n > 0)
+        stack.emplace_back(bc_.Operate(base, labels[--n]), idx_count);
+    }
+  }
+
+  void _save(std::ostream& os, const da_type& bc, const Tail& tail) const {
+    ImageWriter writer(os);
+    writer.WriteValue(MakeImageHeader<da_type>(kImageTrieId, EdgeOrdering));
+    bc.Write(writer);
+    tail.Write(writer);
+    leaves_.Write(writer);
+    writer.WriteVector(links_);
+    writer.WriteVector(less_counts_);
+    writer.Finish();
+  }
+
+  // Rebuild the TAIL from the labels of the leaves of bc, which is a copy of bc_,
+  // dropping the labels no longer referenced.
+  Tail _rebuild_tail(da_type& bc) const {
+    TailConstructor tail_constr;
+    for (size_t i = 0; i < bc.size(); i++) {
+      if (!bc[i].Enabled() or bc[i].HasBase())
+        continue;
+      bc[i].set_tail_i(tail_constr.push(std::string(tail_.label(bc[i].tail_i()))));
+    }
+    tail_constr.Construct();
+    for (size_t i = 0; i < bc.size(); i++) {
+      if (!bc[i].Enabled() or bc[i].HasBase())
+        continue;
+      bc[i].set_tail_i(tail_constr.map_to(bc[i].tail_i()));
+    }
+    return Tail(std::move(tail_constr));
+  }
+
+  void _build_index() {
+    _build_leaves();
+    _build_links();
+    _build_less_counts();
+    tail_garbage_ = 0;
+  }
+
+  template <typename Feed>
+  void _build_from_sorted(Feed feed) {
+    PlainDaMpTrie built;
+    SortedKeysBuilder<da_type, StatsType> builder(built.bc_, &built.tail_, built.build_stats_);
+    feed(builder);
+    builder.Finish();
+    built._build_index();
+    built.build_stats_.Finish(built.bc_, built.tail_.size());
+    *this = std::move(built);
+  }
+
+  bool _has_child(index_type idx) const {
+    if (!bc_[idx].HasBase())
+      return false;
+    auto first = bc_.Operate(bc_[idx].base(), links_[idx].child);
+    return 0 <= first and first < (index_type) bc_.size() and bc_[first].check() == idx;
+  }
+
+  void _expand(index_type pos) {
+    bc_.CheckExpand(pos);
+    if (links_.size() < bc_.size()) {
+      links_.resize(bc_.size());
+      less_counts_.resize(bc_.size());
+      leaves_.resize(bc_.size());
+    }
+  }
+
+  // Link the child at pos labeled by c into the chain of parent in label order.
+  void _link_child(index_type parent, index_type pos, uint8_t c, bool had_child) {
+    links_[pos] = {};
+    if (!had_child or c < links_[parent].child) {
+      links_[pos].sibling = had_child ? links_[parent].child : kLeafChar;
+      links_[parent].child = c;
+      return;
+    }
+    auto base = bc_[parent].base();
+    auto prev = bc_.Operate(base, links_[parent].child);
+    while (links_[prev].sibling != kLeafChar and links_[prev].sibling < c)
+      prev = bc_.Operate(base, links_[prev].sibling);
+    links_[pos].sibling = links_[prev].sibling;
+    links_[prev].sibling = c;
+  }
+
+  void _unlink_child(index_type parent, index_type pos, uint8_t c) {
+    if (links_[parent].child == c) {
+      links_[parent].child = links_[pos].sibling;
+    } else {
+      auto base = bc_[parent].base();
+      auto prev = bc_.Operate(base, links_[parent].child);
+      while (links_[prev].sibling != c)
+        prev = bc_.Operate(base, links_[prev].sibling);
+      links_[prev].sibling = links_[pos].sibling;
+    }
+    links_[pos] = {};
+    leaves_.set(pos, false);
+    bc_.SetDisabled(pos);
+  }
+
+  // Move all children of parent onto new_base, and redirect check of grandchildren.
+  void _move_children(index_type parent, index_type new_base) {
+    auto old_base = bc_[parent].base();
+    for (uint8_t label = links_[parent].child; ; ) {
+      auto from = bc_.Operate(old_base, label);
+      auto to = bc_.Operate(new_base, label);
+      bool has_child = _has_child(from);
+      bc_.SetEnabled(to);
+      bc_[to] = bc_[from];
+      links_[to] = links_[from];
+      less_counts_[to] = less_counts_[from];
+      leaves_.set(to, leaves_[from]);
+      if (has_child) {
+        auto base = bc_[to].base();
+        for (uint8_t c = links_[to].child; ; ) {
+          auto grandchild = bc_.Operate(base, c);
+          bc_[grandchild].set_check(to);
+          c = links_[grandchild].sibling;
+          if (c == kLeafChar)
+            break;
+        }
+      }
+      uint8_t next = links_[from].sibling;
+      links_[from] = {};
+      leaves_.set(from, false);
+      bc_.SetDisabled(from);
+      if (next == kLeafChar)
+        break;
+      label = next;
+    }
+    bc_[parent].set_base(new_base);
+  }
+
+  // Add a child labeled by c to parent, relocating the siblings when its position is occupied.
+  index_type _add_child(index_type parent, uint8_t c) {
+    bool had_child = _has_child(parent);
+    std::vector<uint8_t> children;
+    if (had_child) {
+      auto base = bc_[parent].base();
+      auto pos = bc_.Operate(base, c);
+      if (pos >= 0 and (pos >= (index_type) bc_.size() or !bc_[pos].Enabled())) {
+        _expand(pos);
+        bc_.SetEnabled(pos);
+        bc_[pos].set_check(parent);
+        _link_child(parent, pos, c, had_child);
+        return pos;
+      }
+      for (uint8_t label = links_[parent].child; ; ) {
+        children.push_back(label);
+        label = links_[bc_.Operate(base, label)].sibling;
+        if (label == kLeafChar)
+          break;
       }
-      return tail_i < tail_.size() and tail_[tail_i] == (char) kLeafChar;
     }
+    children.insert(std::upper_bound(children.begin(), children.end(), c), c);
+    auto new_base = bc_.FindBase(children, nullptr, parent);
+    _expand(bc_.Operate(new_base, children.back()));
+    if (had_child)
+      _move_children(parent, new_base);
+    else
+      bc_[parent].set_base(new_base);
+    auto pos = bc_.Operate(new_base, c);
+    bc_.SetEnabled(pos);
+    bc_[pos].set_check(parent);
+    _link_child(parent, pos, c, had_child);
+    return pos;
+  }
+
+  // Add a leaf storing suffix on the TAIL under parent by the transition labeled by c.
+  index_type _add_leaf(index_type parent, uint8_t c, std::string_view suffix, size_t less_count) {
+    auto leaf = _add_child(parent, c);
+    bc_[leaf].set_tail_i(tail_.push(suffix));
+    leaves_.set(leaf, true);
+    less_counts_[leaf] = less_count;
+    return leaf;
+  }
+
+  // Branch the TAIL unit idx where its label and suffix diverge.
+  void _split_tail(index_type idx, std::string_view suffix) {
+    size_t tail_i = bc_[idx].tail_i();
+    auto label = tail_.label(tail_i);
+    size_t l = 0;
+    while (l < label.size() and l < suffix.size() and label[l] == suffix[l])
+      l++;
+    // Either key terminating at the branch, or having the smaller label there, comes first.
+    bool suffix_first = l == suffix.size() or (l < label.size() and (uint8_t) suffix[l] < (uint8_t) label[l]);
+    tail_garbage_ += l < label.size() ? l + 1 : label.size() + 1;
+    bc_[idx].set_base(kInvalidIndex);
+    links_[idx].child = kLeafChar;
+    leaves_.set(idx, false);
+    auto node = idx;
+    for (size_t i = 0; i < l; i++) {
+      node = _add_child(node, label[i]);
+      less_counts_[node] = 0;
+    }
+    // The rest of the label stays on the TAIL from its middle.
+    if (l < label.size()) {
+      auto leaf = _add_child(node, label[l]);
+      bc_[leaf].set_tail_i(tail_i + l + 1);
+      leaves_.set(leaf, true);
+      less_counts_[leaf] = suffix_first ? 1 : 0;
+    } else {
+      _set_terminal(node);
+    }
+    if (l < suffix.size())
+      _add_leaf(node, suffix[l], suffix.substr(l + 1), suffix_first ? 0 : 1);
+    else
+      _set_terminal(node);
+  }
+
+  void _set_terminal(index_type idx) {
+    bc_[idx].set_terminal(true);
+    leaves_.set(idx, true);
   }
 
 };
 
-template <typename DaType, bool EdgeOrdering>
-void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void PlainDaMpTrie<DaType, EdgeOrdering, StatsType>::Build(const KeysetHandler& keyset) {
   // A keys in keyset is required to be sorted and distinct for each keys.
   using key_iterator = typename KeysetHandler::const_iterator;
 
   if constexpr (!EdgeOrdering) {
 
+    for (auto key : keyset)
+      CheckKey(key);
+
     TailConstructor tail_constr;
 
-    size_t cnt_skip = 0;
-    uint64_t time_fb = 0;
+    build_stats_.Clear();
     auto dfs = [&](
         const auto dfs,
         const key_iterator begin,
@@ -339,10 +1404,10 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
         return;
       }
 
-      std::deque<uint8_t> children;
+      std::vector<uint8_t> children;
       auto keyit = begin;
       if (keyit->size() == depth) {
-        children.push_back(kLeafChar);
+        bc_[da_index].set_terminal(true);
         ++keyit;
       }
 
@@ -360,33 +1425,28 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
       its.push_back(end);
 
       assert(!children.empty());
-      auto start_t = std::chrono::high_resolution_clock::now();
-      auto base = bc_.FindBase(children, &cnt_skip);
-      auto end_t = std::chrono::high_resolution_clock::now();
-      time_fb += std::chrono::duration_cast<std::chrono::microseconds>(end_t-start_t).count();
+      auto base = build_stats_.FindBase(bc_, children, da_index);
 
-      bc_[da_index].base = base;
-      CheckExpand(Operate(base, children.back()));
+      bc_[da_index].set_base(base);
+      bc_.CheckExpand(bc_.Operate(base, children.back()));
       for (uint8_t c : children) {
-        auto pos = Operate(base, c);
+        auto pos = bc_.Operate(base, c);
         assert(!bc_[pos].Enabled());
         if (bc_[pos].Enabled()) {
           throw std::logic_error("FindBase is not implemented correctly!");
         }
-        SetEnabled(pos);
-        bc_[pos].check = da_index;
+        bc_.SetEnabled(pos);
+        bc_[pos].set_check(da_index);
       }
 
-      if (children.front() == kLeafChar)
-        children.pop_front();
       for (int i = 0; i < children.size(); i++) {
-        dfs(dfs, its[i], its[i+1], depth+1, Operate(bc_[da_index].base, children[i]));
+        dfs(dfs, its[i], its[i+1], depth+1, bc_.Operate(bc_[da_index].base(), children[i]));
       }
     };
     const index_type root_index = 0;
     bc_.CheckExpand(root_index);
     bc_.SetEnabled(root_index);
-    bc_[root_index].check = std::numeric_limits<index_type>::max();
+    bc_[root_index].set_check(std::numeric_limits<index_type>::max());
     dfs(dfs, keyset.cbegin(), keyset.cend(), 0, root_index);
 
     tail_constr.Construct();
@@ -396,9 +1456,8 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
       bc_[i].set_tail_i(tail_constr.map_to(bc_[i].tail_i()));
     }
     tail_ = Tail(std::move(tail_constr));
-
-    std::cout << "\tCount roops: " << cnt_skip << std::endl;
-    std::cout << "\tFindBase time: " << std::fixed << (double)time_fb/1000000 << " ￿s" << std::endl;
+    _build_index();
+    build_stats_.Finish(bc_, tail_.size());
 
   } else {
 
@@ -407,12 +1466,12 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const KeysetHandler& keyset) {
   }
 }
 
-template <typename DaType, bool EdgeOrdering>
-void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void PlainDaMpTrie<DaType, EdgeOrdering, StatsType>::Build(const RawTrie& trie, const std::vector<uint64_t>& weights) {
   // A keys in keyset is required to be sorted and unique.
+  CheckKeys(trie);
 
-  size_t cnt_skip = 0;
-  uint64_t time_fb = 0;
+  build_stats_.Clear();
 
   std::vector<bool> to_leaf(trie.size());
   auto set_to_leaf = [&](auto f, size_t trie_node) {
@@ -447,10 +1506,7 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
   TailConstructor tail_constr;
   auto da_save_edges = [&](const std::vector<uint8_t>& children, index_type da_index) {
     assert(!children.empty());
-    auto start_t = std::chrono::high_resolution_clock::now();
-    auto base = bc_.FindBase(children, &cnt_skip);
-    auto end_t = std::chrono::high_resolution_clock::now();
-    time_fb += std::chrono::duration_cast<std::chrono::microseconds>(end_t-start_t).count();
+    auto base = build_stats_.FindBase(bc_, children, da_index);
 
     bc_[da_index].set_base(base);
     bc_.CheckExpand(bc_.Operate(base, children.back()));
@@ -465,28 +1521,33 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
     }
   };
 
-  std::vector<int> subtree_size;
-  if constexpr (EdgeOrdering) {
-    subtree_size.resize(trie.size());
-    auto set_trie_size = [&](const auto dfs, int s) -> void {
-      int& sz = subtree_size[s] = 1;
+  // Children are ordered by the weights of subtries, which are the sums of the weights of keys if given,
+  // or the numbers of nodes for EdgeOrdering.
+  std::vector<uint64_t> subtree_weight;
+  if (EdgeOrdering or !weights.empty()) {
+    subtree_weight.resize(trie.size());
+    size_t key_id = 0;
+    auto set_trie_weight = [&](const auto dfs, int s) -> void {
+      uint64_t& w = subtree_weight[s] = weights.empty() ? 1 : 0;
       for (auto [c, t] : trie[s]) {
-        if (t == -1)
-          sz++;
-        else {
+        if (t == -1) {
+          if (!weights.empty() and key_id >= weights.size())
+            throw std::invalid_argument("The number of weights is less than the number of keys.");
+          w += weights.empty() ? 1 : weights[key_id];
+          key_id++;
+        } else {
           dfs(dfs, t);
-          sz += subtree_size[t];
+          w += subtree_weight[t];
         }
       }
     };
-    set_trie_size(set_trie_size, 0);
+    set_trie_weight(set_trie_weight, 0);
+    if (!weights.empty() and key_id != weights.size())
+      throw std::invalid_argument("The number of weights is greater than the number of keys.");
   }
 
-  auto dfs = [&](
-      const auto dfs,
-      int trie_node,
-      index_type da_index
-  ) -> void {
+  // Place the children of trie_node under da_index, and pass each child to visit_child in the order of visits.
+  auto expand = [&](int trie_node, index_type da_index, auto&& visit_child) {
     if (to_leaf[trie_node]) { // Store on the TAIL
       auto suffix = get_suffix_rev(trie_node);
       auto idx = tail_constr.push(suffix);
@@ -497,46 +1558,242 @@ void PlainDaMpTrie<DaType, EdgeOrdering>::Build(const RawTrie& trie) {
     auto& edges = trie[trie_node];
     std::vector<uint8_t> children;
     children.reserve(edges.size());
-    for (auto e : edges)
-      children.push_back(e.c);
+    std::vector<int> order;
+    for (int i = 0; i < edges.size(); i++) {
+      if (edges[i].c == kLeafChar) { // (edges[i].next == -1)
+        bc_[da_index].set_terminal(true);
+      } else {
+        children.push_back(edges[i].c);
+        order.push_back(i);
+      }
+    }
 
     da_save_edges(children, da_index);
 
-    std::deque<int> order(edges.size());
-    std::iota(order.begin(), order.end(), 0);
-    if (children[0] == kLeafChar) // (edges[0].next == -1)
-      order.pop_front();
-    if constexpr (EdgeOrdering) {
-      std::sort(order.begin(), order.end(), [&](int l, int r) {
-        return subtree_size[edges[l].next] > subtree_size[edges[r].next];
+    if (!subtree_weight.empty()) {
+      std::stable_sort(order.begin(), order.end(), [&](int l, int r) {
+        return subtree_weight[edges[l].next] > subtree_weight[edges[r].next];
       });
     }
     for (auto i : order) {
       assert(edges[i].next != -1);
-      dfs(dfs, trie[trie_node][i].next, bc_.Operate(bc_[da_index].base(), children[i]));
+      visit_child(edges[i].next, bc_.Operate(bc_[da_index].base(), edges[i].c));
     }
   };
+  auto dfs = [&](const auto dfs, int trie_node, index_type da_index) -> void {
+    expand(trie_node, da_index, [&](int child, index_type child_index) {
+      dfs(dfs, child, child_index);
+    });
+  };
   const index_type root_index = 0;
   bc_.CheckExpand(root_index);
   bc_.SetEnabled(root_index);
   bc_[root_index].set_check(std::numeric_limits<index_type>::max());
-  dfs(dfs, 0, root_index);
+  if (weights.empty()) {
+    dfs(dfs, 0, root_index);
+  } else {
+    // Expand the heaviest node first instead of the DFS, so that the units on hot paths are packed
+    // from the front of the array regardless of where the hot keys are in the order of keys.
+    std::priority_queue<std::tuple<uint64_t, int, index_type>> queue;
+    queue.emplace(subtree_weight[0], 0, root_index);
+    while (!queue.empty()) {
+      auto [weight, trie_node, da_index] = queue.top();
+      queue.pop();
+      expand(trie_node, da_index, [&](int child, index_type child_index) {
+        queue.emplace(subtree_weight[child], child, child_index);
+      });
+    }
+  }
 
   tail_constr.Construct();
   for (size_t i = 0; i < bc_.size(); i++) {
     if (!bc_[i].Enabled() or bc_[i].HasBase())
       continue;
-    auto c = bc_.RestoreLabel(bc_[bc_[i].check()].base(), i);
-    if (c == kLeafChar)
-      continue;
     auto tail_i = tail_constr.map_to(bc_[i].tail_i());
     assert(tail_i > 0);
     bc_[i].set_tail_i(tail_i);
   }
   tail_ = Tail(std::move(tail_constr));
+  _build_index();
+  build_stats_.Finish(bc_, tail_.size());
+}
+
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+void PlainDaMpTrie<DaType, EdgeOrdering, StatsType>::Relayout(size_t bfs_depth) {
+  if (bc_.size() == 0)
+    return;
+
+  da_type bc;
+  TailConstructor tail_constr;
+  // Place the children of the unit src of this array under the unit dst of the new array.
+  std::vector<uint8_t> children;
+  auto place = [&](index_type src, index_type dst, auto&& visit_child) {
+    auto& unit = bc_[src];
+    if (!unit.HasBase()) {
+      bc[dst].set_tail_i(tail_constr.push(std::string(tail_.label(unit.tail_i()))));
+      return;
+    }
+    bc[dst].set_terminal(unit.IsTerminal());
+    if (!_has_child(src))
+      return;
+    children.clear();
+    for (uint8_t c = links_[src].child; ; ) {
+      children.push_back(c);
+      c = links_[bc_.Operate(unit.base(), c)].sibling;
+      if (c == kLeafChar)
+        break;
+    }
+    auto base = bc.FindBase(children, nullptr, dst);
+    bc[dst].set_base(base);
+    bc.CheckExpand(bc.Operate(base, children.back()));
+    for (uint8_t c : children) {
+      auto pos = bc.Operate(base, c);
+      assert(!bc[pos].Enabled());
+      bc.SetEnabled(pos);
+      bc[pos].set_check(dst);
+    }
+    for (uint8_t c : children)
+      visit_child(bc_.Operate(unit.base(), c), bc.Operate(base, c));
+  };
+
+  const index_type root_index = 0;
+  bc.CheckExpand(root_index);
+  bc.SetEnabled(root_index);
+  bc[root_index].set_check(std::numeric_limits<index_type>::max());
+  // Top levels in breadth-first order
+  std::vector<std::pair<index_type, index_type>> level = {{0, root_index}}, next_level;
+  for (size_t depth = 0; depth < bfs_depth and !level.empty(); depth++) {
+    next_level.clear();
+    for (auto [src, dst] : level) {
+      place(src, dst, [&](index_type child_src, index_type child_dst) {
+        next_level.emplace_back(child_src, child_dst);
+      });
+    }
+    std::swap(level, next_level);
+  }
+  // Subtries below them in depth-first order
+  std::vector<std::pair<index_type, index_type>> stack;
+  for (auto root : level) {
+    stack.push_back(root);
+    while (!stack.empty()) {
+      auto [src, dst] = stack.back();
+      stack.pop_back();
+      auto top = stack.size();
+      place(src, dst, [&](index_type child_src, index_type child_dst) {
+        stack.emplace_back(child_src, child_dst);
+      });
+      std::reverse(stack.begin() + top, stack.end());
+    }
+  }
+
+  tail_constr.Construct();
+  for (size_t i = 0; i < bc.size(); i++) {
+    if (!bc[i].Enabled() or bc[i].HasBase())
+      continue;
+    bc[i].set_tail_i(tail_constr.map_to(bc[i].tail_i()));
+  }
+  bc_ = std::move(bc);
+  tail_ = Tail(std::move(tail_constr));
+  _build_index();
+  image_.reset();
+}
+
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+bool PlainDaMpTrie<DaType, EdgeOrdering, StatsType>::Insert(std::string_view key) {
+  CheckKey(key);
+  if (bc_.size() == 0) {
+    const index_type root_index = 0;
+    _expand(root_index);
+    bc_.SetEnabled(root_index);
+    bc_[root_index].set_check(std::numeric_limits<index_type>::max());
+  }
+
+  // Walk down to the unit where key branches off, keeping the keys before and after the subtrie of the unit.
+  std::vector<index_type> path = {0};
+  size_t less = 0, end = num_keys();
+  size_t depth = 0;
+  for (; ; depth++) {
+    auto idx = path.back();
+    if (!bc_[idx].HasBase()) {
+      if (_tail_equals(bc_[idx].tail_i(), key.substr(depth)))
+        return false;
+      break;
+    }
+    if (depth == key.size()) {
+      if (bc_[idx].IsTerminal())
+        return false;
+      break;
+    }
+    auto nxt = bc_.Operate(bc_[idx].base(), key[depth]);
+    if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+      break;
+    end = _subtrie_end(idx, nxt, less, end);
+    less += less_counts_[nxt];
+    path.push_back(nxt);
+  }
+
+  // Keys in the subtries of the siblings following the path are now preceded by key.
+  for (size_t i = 1; i < path.size(); i++)
+    _shift_following_siblings(path[i-1], path[i], 1);
+  auto idx = path.back();
+  if (!bc_[idx].HasBase()) {
+    _split_tail(idx, key.substr(depth));
+  } else if (depth == key.size()) {
+    _shift_children(idx, 1);
+    _set_terminal(idx);
+  } else {
+    auto next = _next_child(idx, key[depth]);
+    auto leaf = _add_leaf(idx, key[depth], key.substr(depth+1),
+                          next == kInvalidIndex ? end - less : less_counts_[next]);
+    _shift_following_siblings(idx, leaf, 1);
+  }
+  return true;
+}
 
-  std::cout << "\tCount roops: " << cnt_skip << std::endl;
-  std::cout << "\tFindBase time: " << std::fixed << (double)time_fb/1000000 << " ￿s" << std::endl;
+template <typename DaType, bool EdgeOrdering, typename StatsType>
+bool PlainDaMpTrie<DaType, EdgeOrdering, StatsType>::Erase(std::string_view key) {
+  if (empty())
+    return false;
+
+  std::vector<index_type> path = {0};
+  size_t depth = 0;
+  for (; ; depth++) {
+    auto idx = path.back();
+    if (!bc_[idx].HasBase()) {
+      if (!_tail_equals(bc_[idx].tail_i(), key.substr(depth)))
+        return false;
+      break;
+    }
+    if (depth == key.size()) {
+      if (!bc_[idx].IsTerminal())
+        return false;
+      break;
+    }
+    auto nxt = bc_.Operate(bc_[idx].base(), key[depth]);
+    if (nxt >= bc_.size() or bc_[nxt].check() != idx)
+      return false;
+    path.push_back(nxt);
+  }
+
+  for (size_t i = 1; i < path.size(); i++)
+    _shift_following_siblings(path[i-1], path[i], -1);
+  auto leaf = path.back();
+  if (bc_[leaf].HasBase()) {
+    _shift_children(leaf, -1);
+    bc_[leaf].set_terminal(false);
+  } else {
+    tail_garbage_ += tail_.label(bc_[leaf].tail_i()).size() + 1;
+    if (leaf == 0) // The root is a TAIL
+      bc_[leaf].set_base(kInvalidIndex);
+  }
+  leaves_.set(leaf, false);
+  // Remove the units left without keys.
+  for (auto idx = leaf; idx != 0 and !leaves_[idx] and !_has_child(idx); ) {
+    auto parent = bc_[idx].check();
+    _unlink_child(parent, idx, bc_.RestoreLabel(bc_[parent].base(), idx));
+    idx = parent;
+  }
+  return true;
 }
 
 }
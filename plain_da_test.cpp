@@ -0,0 +1,397 @@
+#include "plain_da.hpp"
+
+#include <iostream>
+#include <random>
+#include <set>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+#include "keyset.hpp"
+#include "test_keyset.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 4000;
+constexpr int NumQueries = 4000;
+const char* ImagePath = "plain_da_test.img";
+
+template <class Trie>
+bool TestSearch(const Trie& trie, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  for (auto key : keyset) {
+    if (!trie.contains(key)) {
+      std::cout << "Test failed: " << key << " is not contained" << std::endl;
+      return false;
+    }
+  }
+  std::set<std::string_view> keys(keyset.begin(), keyset.end());
+  std::vector<bool> expected;
+  for (auto key : queries) {
+    bool ok = keys.count(key);
+    if (trie.contains(key) != ok) {
+      std::cout << "Test failed: contains(" << key << ") != " << ok << std::endl;
+      return false;
+    }
+    expected.push_back(ok);
+  }
+
+  std::vector<bool> results;
+  trie.contains_batch(queries.begin(), queries.end(), std::back_inserter(results));
+  if (results != expected) {
+    std::cout << "Test failed: contains_batch differs from contains" << std::endl;
+    return false;
+  }
+
+  if (trie.num_keys() != keyset.size()) {
+    std::cout << "Test failed: num_keys() = " << trie.num_keys() << " != " << keyset.size() << std::endl;
+    return false;
+  }
+  std::vector<bool> used(keyset.size());
+  for (auto key : keyset) {
+    auto id = trie.lookup(key);
+    if (!id or *id >= keyset.size() or used[*id]) {
+      std::cout << "Test failed: lookup(" << key << ") is not a dense unique ID" << std::endl;
+      return false;
+    }
+    used[*id] = true;
+    if (trie.reverse_lookup(*id) != key) {
+      std::cout << "Test failed: reverse_lookup(" << *id << ") = " << trie.reverse_lookup(*id) << " != " << key << std::endl;
+      return false;
+    }
+  }
+  std::vector<std::optional<uint32_t>> ids;
+  trie.lookup_batch(queries.begin(), queries.end(), std::back_inserter(ids));
+  for (size_t i = 0; i < queries.size(); i++) {
+    if (ids[i] != trie.lookup(queries[i])) {
+      std::cout << "Test failed: lookup_batch differs from lookup for " << queries[i] << std::endl;
+      return false;
+    }
+  }
+
+  for (auto key : queries) {
+    std::string text(key);
+    text += "abc";
+    std::vector<std::pair<size_t, uint32_t>> expected_matches;
+    for (size_t len = 0; len <= text.size(); len++) {
+      auto id = trie.lookup(std::string_view(text).substr(0, len));
+      if (id)
+        expected_matches.emplace_back(len, *id);
+    }
+    if (trie.common_prefix_search(text) != expected_matches) {
+      std::cout << "Test failed: common_prefix_search(" << text << ")" << std::endl;
+      return false;
+    }
+    auto longest = trie.longest_prefix(text);
+    if (expected_matches.empty() ? longest.has_value() : longest != expected_matches.back()) {
+      std::cout << "Test failed: longest_prefix(" << text << ")" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class Trie>
+bool TestPredictiveSearch(const Trie& trie, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  for (auto query : queries) {
+    for (size_t len = 0; len <= query.size(); len += 2) {
+      auto prefix = query.substr(0, len);
+      auto first = std::lower_bound(keyset.begin(), keyset.end(), prefix);
+      auto cursor = trie.predictive_search(prefix);
+      for (auto it = first; it != keyset.end() and it->substr(0, len) == prefix; ++it, ++cursor) {
+        if (!cursor or cursor.key() != *it or cursor.id() != trie.lookup(*it)) {
+          std::cout << "Test failed: predictive_search(" << prefix << ") misses " << *it << std::endl;
+          return false;
+        }
+      }
+      if (cursor) {
+        std::cout << "Test failed: predictive_search(" << prefix << ") reports extra " << cursor.key() << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <class Trie>
+bool TestOrderedCursor(const Trie& trie, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  auto cursor = trie.begin();
+  for (auto key : keyset) {
+    if (!cursor or cursor.key() != key) {
+      std::cout << "Test failed: iteration misses " << key << std::endl;
+      return false;
+    }
+    ++cursor;
+  }
+  if (cursor) {
+    std::cout << "Test failed: iteration reports extra " << cursor.key() << std::endl;
+    return false;
+  }
+  std::vector<std::string_view> probes(queries.begin(), queries.end());
+  probes.insert(probes.end(), {"", "a", "ffffffffffff", "g"});
+  for (auto query : probes) {
+    auto lower = std::lower_bound(keyset.begin(), keyset.end(), query);
+    auto lower_cursor = trie.lower_bound(query);
+    if (lower == keyset.end() ? bool(lower_cursor) : !lower_cursor or lower_cursor.key() != *lower) {
+      std::cout << "Test failed: lower_bound(" << query << ")" << std::endl;
+      return false;
+    }
+    auto upper = std::upper_bound(keyset.begin(), keyset.end(), query);
+    auto upper_cursor = trie.upper_bound(query);
+    if (upper == keyset.end() ? bool(upper_cursor) : !upper_cursor or upper_cursor.key() != *upper) {
+      std::cout << "Test failed: upper_bound(" << query << ")" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class Trie>
+bool TestRank(const Trie& trie, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  for (auto query : queries) {
+    size_t expected = std::lower_bound(keyset.begin(), keyset.end(), query) - keyset.begin();
+    if (trie.rank(query) != expected) {
+      std::cout << "Test failed: rank(" << query << ") = " << trie.rank(query) << " != " << expected << std::endl;
+      return false;
+    }
+    for (size_t len = 0; len <= query.size(); len++) {
+      auto prefix = query.substr(0, len);
+      auto first = std::lower_bound(keyset.begin(), keyset.end(), prefix);
+      size_t count = 0;
+      for (auto it = first; it != keyset.end() and it->substr(0, len) == prefix; ++it)
+        count++;
+      if (trie.count_prefix(prefix) != count) {
+        std::cout << "Test failed: count_prefix(" << prefix << ") = " << trie.count_prefix(prefix) << " != " << count << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Load a copy of trie through the image file.
+template <class Trie>
+Trie SaveAndLoad(const Trie& trie) {
+  {
+    std::ofstream ofs(ImagePath, std::ios::binary);
+    trie.Save(ofs);
+  }
+  Trie loaded;
+  loaded.Load(ImagePath);
+  std::remove(ImagePath);
+  return loaded;
+}
+
+// Load rejects truncated or extended images, and Save reports a failed stream.
+template <class Trie>
+bool TestBrokenImage(const Trie& trie) {
+  std::ostringstream oss;
+  trie.Save(oss);
+  auto image = oss.str();
+  for (auto& broken : {image.substr(0, image.size() - 1),
+                       image.substr(0, image.size() / 2),
+                       image + std::string(8, '\0')}) {
+    {
+      std::ofstream ofs(ImagePath, std::ios::binary);
+      ofs << broken;
+    }
+    Trie loaded;
+    try {
+      loaded.Load(ImagePath);
+      std::cout << "Test failed: broken image of " << broken.size() << " bytes is loaded" << std::endl;
+      std::remove(ImagePath);
+      return false;
+    } catch (const std::runtime_error&) {}
+  }
+  std::remove(ImagePath);
+  std::ofstream unopened;
+  try {
+    trie.Save(unopened);
+    std::cout << "Test failed: Save to a failed stream succeeds" << std::endl;
+    return false;
+  } catch (const std::runtime_error&) {}
+  return true;
+}
+
+const std::string NulKey("ab\0c", 4);
+
+template <typename Function>
+bool Rejects(Function f) {
+  try {
+    f();
+    return false;
+  } catch (const std::invalid_argument&) {
+    return true;
+  }
+}
+
+// Keys containing '\0' are rejected by every way of building the MP-trie.
+template <class Trie>
+bool TestNulKey() {
+  auto keyset = plain_da::MakeTestKeyset({"a", NulKey});
+  std::vector<std::string> sorted_keys = {"a", NulKey};
+  if (!Rejects([&] { Trie built; built.Build(keyset); }) or
+      !Rejects([&] { Trie built; built.Build(plain_da::RawTrie(keyset)); }) or
+      !Rejects([&] { Trie built; built.BuildFromSorted(sorted_keys.begin(), sorted_keys.end()); })) {
+    std::cout << "Test failed: a key containing NUL is built" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Keys containing '\0' are built by every way of building PlainDaTrie.
+template <class Trie>
+bool TestNulKeySearch() {
+  using namespace std::string_literals;
+  std::vector<std::string> keys = {""s, "\0"s, "\0a"s, "a"s, "a\0"s, NulKey, "b"s};
+  auto keyset = plain_da::MakeTestKeyset(keys);
+  auto queries = plain_da::MakeTestKeyset({"\0\0"s, "\0a"s, "\0b"s, "a\0\0"s, "ab"s, "ab\0"s, "b\0"s});
+  Trie from_raw(plain_da::RawTrie{keyset});
+  Trie from_sorted;
+  from_sorted.BuildFromSorted(keys.begin(), keys.end());
+  return TestSearch(Trie(keyset), keyset, queries) and
+      TestSearch(from_raw, keyset, queries) and
+      TestSearch(from_sorted, keyset, queries);
+}
+
+// Insert rejects keys containing '\0' leaving the trie unchanged.
+template <class Trie>
+bool TestNulInsert(const Trie& trie) {
+  auto inserted = trie;
+  if (!Rejects([&] { inserted.Insert(NulKey); }) or inserted.num_keys() != trie.num_keys() or
+      inserted.contains(NulKey) or inserted.contains(std::string("\0", 1))) {
+    std::cout << "Test failed: a key containing NUL is inserted" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <class Trie>
+bool TestAll(const Trie& trie, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  return TestSearch(trie, keyset, queries) and
+      TestPredictiveSearch(trie, keyset, queries) and
+      TestOrderedCursor(trie, keyset, queries) and
+      TestRank(trie, keyset, queries);
+}
+
+template <class Trie>
+bool TestUpdate(const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  std::vector<std::string> initial_keys, inserted_keys;
+  for (size_t i = 0; i < keyset.size(); i++)
+    (i % 2 == 0 ? initial_keys : inserted_keys).emplace_back(keyset[i]);
+  auto trie = SaveAndLoad(Trie(plain_da::RawTrie{plain_da::MakeTestKeyset(initial_keys)}));
+  std::shuffle(inserted_keys.begin(), inserted_keys.end(), std::mt19937(2));
+  for (auto& key : inserted_keys) {
+    if (!trie.Insert(key) or trie.Insert(key)) {
+      std::cout << "Test failed: Insert(" << key << ")" << std::endl;
+      return false;
+    }
+  }
+  if (!TestAll(trie, keyset, queries))
+    return false;
+
+  std::vector<std::string> remaining_keys;
+  for (size_t i = 0; i < keyset.size(); i++) {
+    if (i % 3 != 0) {
+      remaining_keys.emplace_back(keyset[i]);
+    } else if (!trie.Erase(keyset[i]) or trie.Erase(keyset[i])) {
+      std::cout << "Test failed: Erase(" << keyset[i] << ")" << std::endl;
+      return false;
+    }
+  }
+  if (!TestAll(trie, plain_da::MakeTestKeyset(remaining_keys), queries))
+    return false;
+  // Labels left by the updates are dropped from the image.
+  auto saved = SaveAndLoad(trie);
+  if (trie.tail_garbage() == 0 or saved.tail_garbage() != 0 or
+      saved.memory_usage().tail >= trie.memory_usage().tail) {
+    std::cout << "Test failed: TAIL garbage " << trie.tail_garbage() << " is not reclaimed on Save" << std::endl;
+    return false;
+  }
+  if (!TestAll(saved, plain_da::MakeTestKeyset(remaining_keys), queries))
+    return false;
+  trie.Relayout();
+  if (!TestAll(trie, plain_da::MakeTestKeyset(remaining_keys), queries))
+    return false;
+
+  for (auto& key : remaining_keys)
+    trie.Erase(key);
+  if (!trie.empty() or trie.begin()) {
+    std::cout << "Test failed: trie is not empty after erasing all keys" << std::endl;
+    return false;
+  }
+
+  Trie empty_trie;
+  std::vector<std::string> keys(keyset.begin(), keyset.end());
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+  for (auto& key : keys)
+    empty_trie.Insert(key);
+  return TestAll(empty_trie, keyset, queries);
+}
+
+template <class Trie>
+bool Test(const std::string& name, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie trie(plain_da::RawTrie{keyset});
+  if (!TestSearch(trie, keyset, queries) or
+      !TestSearch(SaveAndLoad(trie), keyset, queries) or
+      !TestBrokenImage(trie) or
+      !TestNulKeySearch<Trie>())
+    return false;
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <class Trie>
+bool TestMp(const std::string& name, const plain_da::KeysetHandler& keyset, const plain_da::KeysetHandler& queries) {
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie trie(plain_da::RawTrie{keyset});
+  auto relaid = SaveAndLoad(trie);
+  relaid.Relayout();
+  // Skewed weights where a few keys are hot
+  std::mt19937 gen(4);
+  std::vector<uint64_t> weights(keyset.size());
+  for (auto& w : weights)
+    w = gen() % 100 == 0 ? 1000000 : gen() % 10;
+  Trie weighted(plain_da::RawTrie{keyset}, weights);
+  if (!TestAll(trie, keyset, queries) or
+      !TestAll(SaveAndLoad(trie), keyset, queries) or
+      !TestBrokenImage(trie) or
+      !TestNulKey<Trie>() or
+      !TestNulInsert(trie) or
+      !TestAll(relaid, keyset, queries) or
+      !TestAll(weighted, keyset, queries) or
+      !TestUpdate<Trie>(keyset, queries))
+    return false;
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <typename OperationTag, typename ConstructionType, typename PlacementTag = plain_da::first_fit_placement_tag>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType, PlacementTag>;
+
+}
+
+int main() {
+  auto keyset = plain_da::MakeTestKeyset(plain_da::MakeTestKeys(NumKeys, 0));
+  auto queries = plain_da::MakeTestKeyset(plain_da::MakeTestKeys(NumQueries, 1));
+
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<PlainDaTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>("PlainDa+ ELM", keyset, queries);
+  ok &= Test<PlainDaTrie<Da<da_plus_operation_tag, WW_xcheck_tag>, true>>("PlainDa+ WW", keyset, queries);
+  ok &= Test<PlainDaTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>("PlainDax WW", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>("MP+ ELM", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_plus_operation_tag, WW_ELM_xcheck_tag>, true>>("MP+ WW_ELM", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_plus_operation_tag, ELM_xcheck_tag, cache_line_placement_tag>, false>>("MP+ ELM cache-line placement", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_plus_operation_tag, CNV_xcheck_tag>, false>>("MP+ CNV", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_plus_operation_tag, CNV_ELM_xcheck_tag>, false>>("MP+ CNV_ELM", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_xor_operation_tag, ELM_xcheck_tag>, false>>("MPx ELM", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>("MPx WW", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_xor_operation_tag, WW_xcheck_tag, cache_line_placement_tag>, false>>("MPx WW cache-line placement", keyset, queries);
+  ok &= TestMp<PlainDaMpTrie<Da<da_xor_operation_tag, CNV_xcheck_tag>, false>>("MPx CNV", keyset, queries);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#ifndef PLAIN_DA_TRIES__SORTED_KEYS_BUILDER_HPP_
+#define PLAIN_DA_TRIES__SORTED_KEYS_BUILDER_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <limits>
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+
+#include "definition.hpp"
+#include "keyset.hpp"
+#include "double_array_base.hpp"
+#include "tail.hpp"
+#include "build_stats.hpp"
+
+namespace plain_da {
+
+// Builder of a double array from sorted distinct keys given one at a time.
+// Only the nodes on the path of the last key are kept open. Once a key leaves the subtrie of a node,
+// the children of the node are placed bottom-up, and the node itself is written when its parent is placed.
+// Children are placed before the index of their parent is known, so their check is redirected on the placement
+// of the parent, which is cheap as the labels of the children are kept until then.
+// For the same reason, FindBase is given no parent index, so that the placement policy of DaType gets no hint.
+// If tail is given, subtries of a single key are stored on the TAIL as the MP-trie, and keys are required
+// not to contain '\0' as CheckKey.
+template <typename DaType, typename StatsType = NoBuildStats>
+class SortedKeysBuilder {
+ private:
+  static constexpr index_type kRootIndex = 0;
+
+  // Closed child of an open node.
+  struct Child {
+    uint8_t label;
+    // Whether the child is a single key whose rest is kept in suffix_rev until it is placed on the TAIL.
+    bool on_tail = false;
+    bool terminal = false;
+    index_type base = kInvalidIndex;
+    std::string suffix_rev;
+    // Labels of the children of the child placed on base.
+    std::vector<uint8_t> labels;
+  };
+
+  // Open node on the path of the last key.
+  struct Node {
+    bool terminal = false;
+    std::vector<Child> children;
+  };
+
+  DaType& bc_;
+  Tail* tail_;
+  StatsType& stats_;
+  std::string last_key_;
+  // Open nodes of depth [0, depth_] are path_[0, depth_], and the rest are kept to reuse their buffers.
+  std::vector<Node> path_;
+  size_t depth_ = 0;
+  size_t num_keys_ = 0;
+
+ public:
+  SortedKeysBuilder(DaType& bc, Tail* tail, StatsType& stats) : bc_(bc), tail_(tail), stats_(stats), path_(1) {
+    bc_.CheckExpand(kRootIndex);
+    bc_.SetEnabled(kRootIndex);
+    bc_[kRootIndex].set_check(std::numeric_limits<index_type>::max());
+  }
+
+  size_t num_keys() const { return num_keys_; }
+
+  void Add(std::string_view key) {
+    if (tail_)
+      CheckKey(key);
+    size_t lcp = 0;
+    if (num_keys_ > 0) {
+      if (key <= last_key_)
+        throw std::invalid_argument("Keys are required to be sorted and distinct.");
+      while (lcp < key.size() and lcp < last_key_.size() and key[lcp] == last_key_[lcp])
+        lcp++;
+    }
+    _close_to(lcp);
+    for (; depth_ < key.size(); depth_++) {
+      if (path_.size() == depth_ + 1)
+        path_.emplace_back();
+      path_[depth_ + 1].terminal = false;
+      path_[depth_ + 1].children.clear();
+    }
+    path_[depth_].terminal = true;
+    last_key_ = key;
+    num_keys_++;
+  }
+
+  // Place the rest of nodes. The array is complete after this.
+  void Finish() {
+    _close_to(0);
+    auto& root = path_[0];
+    if (num_keys_ == 0)
+      return;
+    if (tail_ and _single_key(root)) {
+      bc_[kRootIndex].set_tail_i(_push_tail(root));
+      return;
+    }
+    if (!root.children.empty())
+      bc_[kRootIndex].set_base(_place_children(root));
+    if (root.terminal)
+      bc_[kRootIndex].set_terminal(true);
+  }
+
+ private:
+  void _close_to(size_t depth) {
+    for (; depth_ > depth; depth_--) {
+      auto& node = path_[depth_];
+      auto& parent = path_[depth_ - 1];
+      parent.children.emplace_back();
+      auto& child = parent.children.back();
+      child.label = last_key_[depth_ - 1];
+      if (tail_ and _single_key(node)) {
+        child.on_tail = true;
+        if (!node.children.empty()) {
+          child.suffix_rev = std::move(node.children[0].suffix_rev);
+          child.suffix_rev += (char) node.children[0].label;
+        }
+        continue;
+      }
+      child.terminal = node.terminal;
+      if (!node.children.empty()) {
+        child.base = _place_children(node);
+        for (auto& c : node.children)
+          child.labels.push_back(c.label);
+      }
+    }
+  }
+
+  static bool _single_key(const Node& node) {
+    if (node.children.empty())
+      return node.terminal;
+    return !node.terminal and node.children.size() == 1 and node.children[0].on_tail;
+  }
+
+  index_type _push_tail(const Node& node) {
+    std::string suffix;
+    if (!node.children.empty()) {
+      suffix = node.children[0].suffix_rev;
+      suffix += (char) node.children[0].label;
+      std::reverse(suffix.begin(), suffix.end());
+    }
+    return tail_->push(suffix);
+  }
+
+  // Place the closed children of node, and return the base.
+  index_type _place_children(const Node& node) {
+    std::vector<uint8_t> labels;
+    labels.reserve(node.children.size());
+    for (auto& c : node.children)
+      labels.push_back(c.label);
+    auto base = stats_.FindBase(bc_, labels, kInvalidIndex);
+    bc_.CheckExpand(bc_.Operate(base, labels.back()));
+    for (auto& c : node.children) {
+      auto pos = bc_.Operate(base, c.label);
+      assert(!bc_[pos].Enabled());
+      if (bc_[pos].Enabled())
+        throw std::logic_error("FindBase is not implemented correctly!");
+      bc_.SetEnabled(pos);
+      // Redirected to the parent when the parent is placed, unless the parent is the root.
+      bc_[pos].set_check(kRootIndex);
+      if (c.on_tail) {
+        std::string suffix(c.suffix_rev.rbegin(), c.suffix_rev.rend());
+        bc_[pos].set_tail_i(tail_->push(suffix));
+        continue;
+      }
+      if (c.base != kInvalidIndex) {
+        bc_[pos].set_base(c.base);
+        for (uint8_t label : c.labels)
+          bc_[bc_.Operate(c.base, label)].set_check(pos);
+      }
+      if (c.terminal)
+        bc_[pos].set_terminal(true);
+    }
+    return base;
+  }
+};
+
+}
+
+#endif //PLAIN_DA_TRIES__SORTED_KEYS_BUILDER_HPP_
@@ -0,0 +1,121 @@
+#include "sorted_keys_builder.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <set>
+#include <type_traits>
+
+#include "plain_da.hpp"
+#include "keyset_generator.hpp"
+#include "double_array_base.hpp"
+
+namespace {
+
+constexpr int NumKeys = 5000;
+
+template <class Trie, class = void>
+struct HasInsert : std::false_type {};
+template <class Trie>
+struct HasInsert<Trie, std::void_t<decltype(std::declval<Trie&>().Insert(std::string_view()))>> : std::true_type {};
+
+template <class Trie>
+bool TestKeys(const std::string& name, const std::vector<std::string>& keys) {
+  std::cout << "Test " << name << "..." << std::endl;
+  Trie trie;
+  trie.BuildFromSorted(keys.begin(), keys.end());
+  if (trie.num_keys() != keys.size()) {
+    std::cout << "Test failed: num_keys = " << trie.num_keys() << " for " << keys.size() << " keys" << std::endl;
+    return false;
+  }
+  std::set<uint32_t> ids;
+  for (auto& key : keys) {
+    auto id = trie.lookup(key);
+    if (!id or *id >= keys.size() or !ids.insert(*id).second) {
+      std::cout << "Test failed: " << key << " is not contained with a unique ID" << std::endl;
+      return false;
+    }
+    if (trie.reverse_lookup(*id) != key) {
+      std::cout << "Test failed: ID of " << key << " is restored to " << trie.reverse_lookup(*id) << std::endl;
+      return false;
+    }
+    for (auto& mutated : {key + "~", key.substr(0, key.size() / 2)}) {
+      if (!std::binary_search(keys.begin(), keys.end(), mutated) and trie.contains(mutated)) {
+        std::cout << "Test failed: " << mutated << " is contained" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  // The same trie is built from a stream.
+  std::stringstream ss;
+  for (auto& key : keys)
+    ss << key << '\n';
+  Trie streamed;
+  streamed.BuildFromSorted(ss);
+  if (streamed.size() != trie.size() or streamed.num_keys() != trie.num_keys()) {
+    std::cout << "Test failed: trie built from the stream differs" << std::endl;
+    return false;
+  }
+
+  // The trie built bottom-up is updated as the trie built by Build.
+  if constexpr (HasInsert<Trie>::value) {
+    std::string new_key = keys.empty() ? "new" : keys[keys.size() / 2] + "new";
+    if (!trie.Insert(new_key) or !trie.contains(new_key) or
+        !trie.Erase(new_key) or trie.contains(new_key) or trie.num_keys() != keys.size()) {
+      std::cout << "Test failed: update of " << new_key << std::endl;
+      return false;
+    }
+  }
+  std::cout << "OK" << std::endl;
+  return true;
+}
+
+template <class Trie>
+bool Test(const std::string& name) {
+  using namespace plain_da;
+  bool ok = true;
+  for (auto shape : {KeysetShape::kUrl, KeysetShape::kWord, KeysetShape::kPath})
+    ok &= TestKeys<Trie>(name + " " + std::string(kKeysetShapeNames[(int) shape]), GenerateKeyset(shape, NumKeys, 0));
+  ok &= TestKeys<Trie>(name + " edge cases", {"", "a", "ab", "abc", "b"});
+  ok &= TestKeys<Trie>(name + " single key", {"single"});
+  ok &= TestKeys<Trie>(name + " no keys", {});
+
+  std::cout << "Test " << name << " unsorted keys..." << std::endl;
+  std::vector<std::string> unsorted = {"a", "c", "b"};
+  Trie trie;
+  try {
+    trie.BuildFromSorted(unsorted.begin(), unsorted.end());
+    std::cout << "Test failed: unsorted keys are accepted" << std::endl;
+    return false;
+  } catch (const std::invalid_argument&) {
+    std::cout << "OK" << std::endl;
+  }
+
+  std::cout << "Test " << name << " duplicate keys..." << std::endl;
+  std::vector<std::string> duplicate = {"a", "b", "b"};
+  try {
+    trie.BuildFromSorted(duplicate.begin(), duplicate.end());
+    std::cout << "Test failed: duplicate keys are accepted" << std::endl;
+    return false;
+  } catch (const std::invalid_argument&) {
+    std::cout << "OK" << std::endl;
+  }
+  return ok;
+}
+
+template <typename OperationTag, typename ConstructionType>
+using Da = plain_da::DoubleArrayBase<OperationTag, ConstructionType>;
+
+}
+
+int main() {
+  using namespace plain_da;
+  bool ok = true;
+  ok &= Test<PlainDaTrie<Da<da_plus_operation_tag, ELM_xcheck_tag>, false>>("BuildFromSorted PlainDa+ ELM");
+  ok &= Test<PlainDaTrie<Da<da_xor_operation_tag, WW_xcheck_tag>, false>>("BuildFromSorted PlainDax WW");
+  ok &= Test<PlainDaMpTrie<Da<da_plus_operation_tag, CNV_xcheck_tag>, false>>("BuildFromSorted MP+ CNV");
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, WW_ELM_xcheck_tag>, false>>("BuildFromSorted MPx WW_ELM");
+  ok &= Test<PlainDaMpTrie<Da<da_xor_operation_tag, ELM_xcheck_tag>, true>>("BuildFromSorted MPx ELM EdgeOrdering");
+
+  return ok ? 0 : 1;
+}
@@ -7,6 +7,9 @@
 #include <queue>
 #include <cassert>
 
+#include "definition.hpp"
+#include "image.hpp"
+
 namespace plain_da {
 
 class TailConstructor {
@@ -82,7 +85,7 @@ class TailConstructor {
 
 class Tail {
  private:
-  std::vector<char> arr_;
+  MappableVector<char> arr_;
 
  public:
   Tail() = default;
@@ -90,11 +93,40 @@ class Tail {
 
   size_t size() const { return arr_.size(); }
 
+  size_t size_in_bytes() const { return arr_.size_in_bytes(); }
+
+  void Write(ImageWriter& writer) const {
+    writer.WriteVector(arr_);
+  }
+
+  void Map(ImageReader& reader) {
+    reader.MapVector(arr_);
+    CheckImageSection(arr_.empty() or arr_.back() == kLeafChar, "TAIL");
+  }
+
   char operator[](size_t i) const { return arr_[i]; }
 
+  void Prefetch(size_t i) const {
+    if (i < arr_.size())
+      __builtin_prefetch(arr_.data() + i);
+  }
+
   std::string_view label(size_t i) const {
     return std::string_view(arr_.data() + i);
   }
+
+  // Append a label and returns its position.
+  size_t push(std::string_view label) {
+    if (arr_.empty())
+      arr_.push_back(kLeafChar);
+    auto idx = arr_.size();
+    if (idx + label.size() >= 1ull << 31) {
+      throw "Too large tail length for embedded 31bit pointer.";
+    }
+    arr_.insert(arr_.end(), label.begin(), label.end());
+    arr_.push_back(kLeafChar);
+    return idx;
+  }
 };
 
 }
@@ -0,0 +1,37 @@
+#ifndef PLAIN_DA_TRIES__TEST_KEYSET_HPP_
+#define PLAIN_DA_TRIES__TEST_KEYSET_HPP_
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "keyset.hpp"
+
+namespace plain_da {
+
+// Sorted n distinct keys of up to 10 characters of 'a'-'f' for tests, sharing many prefixes.
+inline std::vector<std::string> MakeTestKeys(size_t n, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::set<std::string> keys;
+  while (keys.size() < n) {
+    std::string key;
+    int len = 1 + gen() % 10;
+    for (int i = 0; i < len; i++)
+      key += (char) ('a' + gen() % 6);
+    keys.insert(key);
+  }
+  return {keys.begin(), keys.end()};
+}
+
+inline KeysetHandler MakeTestKeyset(const std::vector<std::string>& keys) {
+  KeysetHandler keyset;
+  for (auto& key : keys)
+    keyset.insert(key);
+  keyset.update_list();
+  return keyset;
+}
+
+}
+
+#endif //PLAIN_DA_TRIES__TEST_KEYSET_HPP_